@@ -9,8 +9,26 @@ namespace Constants
     constexpr int LINE_HEIGHT = 2;
     constexpr int TOTAL_HEIGHT = ITEM_HEIGHT + LINE_HEIGHT;
     constexpr int MARGIN = 10;
+    // 窗口的初始大小, 之后可以拖动改变
     const int WINDOW_WIDTH = 1500;
     const int WINDOW_HEIGHT = 800;
+    constexpr int MIN_PLOT_SIZE = 200;
+    constexpr const char* FONT_PATH = "C:/Windows/Fonts/msyh.ttc";
+    constexpr const char* TRACE_PATH = "trace.json";
+    constexpr Uint32 PREVIEW_DELAY = 300;
+    // 滚轮停止后的这段时间 (毫秒) 内仍按拖动处理, 补不完的方程沿用映射后的旧图层
+    constexpr Uint32 SETTLE_DELAY = 150;
+    // 后台线程每一片补全的时间 (毫秒), 每片结束时发布一次结果并检查新的快照
+    constexpr double PLOT_BUDGET = 12.0;
+    // 画质档位: 细网格节点间距相对默认值的倍数, 从低到高; F5 切换
+    constexpr double QUALITY_SCALES[] = {1.6, 1.0, 0.6};
+    constexpr int QUALITY_LEVELS = 3;
+    constexpr int DEFAULT_QUALITY = 1;
+    constexpr int SHADE_LEVELS = 8;
+    constexpr double CURVE_RADIUS = 0.75;
+    // 折线化简允许的最大偏差 (像素)
+    constexpr double CONTOUR_TOLERANCE = 0.5;
+    constexpr Uint8 REGION_ALPHA = 96;
 
     const SDL_Color BACKGROUND_COLOR = {40, 40, 40, 255};
     const SDL_Color GRID_COLOR = {80, 80, 80, 255};
@@ -20,4 +38,5 @@ namespace Constants
     const SDL_Color BUTTON_COLOR = {80, 80, 160, 255};
     const SDL_Color SELECT_COLOR = {100, 100, 200, 255};
     const SDL_Color EDIT_COLOR = {150, 150, 250, 255};
+    const SDL_Color ERROR_COLOR = {220, 60, 60, 255};
 }
\ No newline at end of file
@@ -14,12 +14,25 @@ enum class RelationalOperator : int
     INVALID
 };
 
+// 可以直接解出一个变量的方程: y = f(x) 或 x = g(y)
+enum class ExplicitForm : int
+{
+    NONE,
+    Y_OF_X,
+    X_OF_Y
+};
+
 struct Equation
 {
     static eval::evaluator<char,double> evaluator;
     std::string expression;
     RelationalOperator type = RelationalOperator::INVALID;
     eval::epre<double> value;//left - right
+    std::shared_ptr<const eval::program<double>> program;
+    ExplicitForm form = ExplicitForm::NONE;
+    std::shared_ptr<const eval::program<double>> function;//显式方程中另一侧的表达式
     SDL_Color color{241,49,49,255};
     bool shown=true;
+    double cost = 0.0;//每个采样点的平均耗时 (纳秒), 由绘制结果填入
+    std::string error;//求值失败的原因
 };
\ No newline at end of file
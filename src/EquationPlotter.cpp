@@ -0,0 +1,1398 @@
+#include "EquationPlotter.hpp"
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    constexpr size_t LEAF_NODES = 16;
+    constexpr size_t PREVIEW_SCALE = 2;
+    constexpr double UNSAMPLED = std::numeric_limits<double>::max();
+    // 显式方程每个像素区间最多对分的次数, 区间中点偏离弦的容差, 以及不再细分时一段允许的最大跨度 (像素)
+    constexpr int EXPLICIT_DEPTH = 10;
+    constexpr double EXPLICIT_FLATNESS = 0.1;
+    constexpr double EXPLICIT_SPAN = 16.0;
+    // 耗时滑动平均中新测量值的权重
+    constexpr double COST_SMOOTHING = 0.3;
+    // 预计剩余耗时超过这么多个预算的方程先停在粗网格, 等其余方程补完再继续
+    constexpr double DEGRADE_BUDGETS = 4.0;
+
+    // 缓冲容量不足, 或比当前档位需要的大一倍以上时才重新分配, 原有内容不保留
+    template <typename T>
+    void reserveClass(std::vector<T>& buffer, size_t capacity)
+    {
+        if (buffer.capacity() >= capacity && buffer.capacity() <= capacity * 2)
+            return;
+        std::vector<T>().swap(buffer);
+        buffer.reserve(capacity);
+    }
+
+    void updateCost(PlotResult& result, const std::shared_ptr<const eval::program<double>>& program, double ms, size_t samples)
+    {
+        if (!samples)
+            return;
+        const double measured = ms * 1e6 / static_cast<double>(samples);
+        if (result.costProgram != program)
+        {
+            result.costProgram = program;
+            result.cost = measured;
+            return;
+        }
+        result.cost += (measured - result.cost) * COST_SMOOTHING;
+    }
+
+    bool isundef(double value)
+    {
+        return std::isnan(value) || std::isinf(value);
+    }
+
+    bool crosses(double v11, double v12, double v21, double v22)
+    {
+        if (isundef(v11) || isundef(v12) || isundef(v21) || isundef(v22))
+            return false;
+        const bool positive = v11 >= 0;
+        return (v12 >= 0) != positive || (v21 >= 0) != positive || (v22 >= 0) != positive;
+    }
+
+    // 边上变号但两端导数都与变化方向相反, 说明跨过的是极点而不是零点
+    bool isPole(double a, double b, double da, double db)
+    {
+        if ((a >= 0) == (b >= 0))
+            return false;
+        return b > a ? da < 0 && db < 0 : da > 0 && db > 0;
+    }
+
+    // 点在不等式区域内时为正, 其余情况 (含无定义) 为负或 NaN
+    double insideness(RelationalOperator type, double value)
+    {
+        switch (type)
+        {
+        case RelationalOperator::NOT_EQUAL:
+            return std::abs(value) <= 1e16 ? 1.0 : -1.0;
+        case RelationalOperator::GREATER_THAN:
+        case RelationalOperator::GREATER_THAN_OR_EQUAL:
+            return value;
+        case RelationalOperator::LESS_THAN:
+        case RelationalOperator::LESS_THAN_OR_EQUAL:
+            return -value;
+        default:
+            return -1.0;
+        }
+    }
+
+    bool isContour(RelationalOperator type)
+    {
+        return type == RelationalOperator::EQUAL || type == RelationalOperator::GREATER_THAN_OR_EQUAL || type == RelationalOperator::LESS_THAN_OR_EQUAL;
+    }
+
+    int lerp(double a, double b, size_t size)
+    {
+        return static_cast<int>(std::round(a * size / (a - b)));
+    }
+
+    void marchingSquares(std::vector<Segment>& out, int sx, int sy, int step, double v11, double v12, double v21, double v22)
+    {
+        if (isundef(v11) || isundef(v12) || isundef(v21) || isundef(v22))
+            return;
+
+        const char state =
+            ((v11 >= 0) ? 1 : 0) |
+            ((v12 >= 0) ? 2 : 0) |
+            ((v21 >= 0) ? 4 : 0) |
+            ((v22 >= 0) ? 8 : 0);
+
+        switch (state)
+        {
+        case 0b0001:
+        case 0b1110:
+            out.push_back({sx + lerp(v11, v12, step), sy, sx, sy + lerp(v11, v21, step)});
+            break;
+        case 0b0010:
+        case 0b1101:
+            out.push_back({sx + lerp(v11, v12, step), sy, sx + step, sy + lerp(v12, v22, step)});
+            break;
+        case 0b0100:
+        case 0b1011:
+            out.push_back({sx + lerp(v21, v22, step), sy + step, sx, sy + lerp(v11, v21, step)});
+            break;
+        case 0b1000:
+        case 0b0111:
+            out.push_back({sx + lerp(v21, v22, step), sy + step, sx + step, sy + lerp(v12, v22, step)});
+            break;
+        case 0b0011:
+        case 0b1100:
+            out.push_back({sx, sy + lerp(v11, v21, step), sx + step, sy + lerp(v12, v22, step)});
+            break;
+        case 0b1010:
+        case 0b0101:
+            out.push_back({sx + lerp(v11, v12, step), sy, sx + lerp(v21, v22, step), sy + step});
+            break;
+        case 0b0110:
+            out.push_back({sx + lerp(v11, v12, step), sy, sx + step, sy + lerp(v12, v22, step)});
+            out.push_back({sx + lerp(v21, v22, step), sy + step, sx, sy + lerp(v11, v21, step)});
+            break;
+        case 0b1001:
+            out.push_back({sx + lerp(v11, v12, step), sy, sx, sy + lerp(v11, v21, step)});
+            out.push_back({sx + lerp(v21, v22, step), sy + step, sx + step, sy + lerp(v12, v22, step)});
+            break;
+        }
+    }
+
+    long long pointKey(int x, int y)
+    {
+        return static_cast<long long>(static_cast<unsigned long long>(static_cast<unsigned int>(x)) << 32 | static_cast<unsigned int>(y));
+    }
+
+    // Douglas-Peucker: 只保留偏离化简后折线超过 tolerance 像素的顶点
+    void simplify(const std::vector<SDL_Point>& line, double tolerance, std::vector<SDL_Point>& out)
+    {
+        std::vector<char> keep(line.size(), 0);
+        keep.front() = keep.back() = 1;
+        std::vector<std::pair<size_t, size_t>> pending{{0, line.size() - 1}};
+        while (!pending.empty())
+        {
+            const auto [a, b] = pending.back();
+            pending.pop_back();
+            const double dx = line[b].x - line[a].x;
+            const double dy = line[b].y - line[a].y;
+            const double length2 = dx * dx + dy * dy;
+            double worst = tolerance;
+            size_t farthest = a;
+            for (size_t i = a + 1; i < b; ++i)
+            {
+                // 到线段 (而非直线) 的距离, 首尾重合的闭合曲线也适用
+                const double px = line[i].x - line[a].x;
+                const double py = line[i].y - line[a].y;
+                const double t = length2 > 0 ? std::clamp((px * dx + py * dy) / length2, 0.0, 1.0) : 0.0;
+                const double distance = std::hypot(px - t * dx, py - t * dy);
+                if (distance > worst)
+                {
+                    worst = distance;
+                    farthest = i;
+                }
+            }
+            if (farthest == a)
+                continue;
+            keep[farthest] = 1;
+            pending.push_back({a, farthest});
+            pending.push_back({farthest, b});
+        }
+        for (size_t i = 0; i < line.size(); ++i)
+            if (keep[i])
+                out.push_back(line[i]);
+    }
+
+    // 线段 (a, b) 与矩形 [x0, x1] x [y0, y1] 的交, 完全在外时返回 false
+    bool clipSegment(Point2D& a, Point2D& b, double x0, double y0, double x1, double y1)
+    {
+        double t0 = 0.0, t1 = 1.0;
+        const double dx = b.x - a.x;
+        const double dy = b.y - a.y;
+        const double p[4] = {-dx, dx, -dy, dy};
+        const double q[4] = {a.x - x0, x1 - a.x, a.y - y0, y1 - a.y};
+        for (int k = 0; k < 4; k++)
+        {
+            if (p[k] == 0)
+            {
+                if (q[k] < 0)
+                    return false;
+                continue;
+            }
+            const double t = q[k] / p[k];
+            if (p[k] < 0)
+                t0 = std::max(t0, t);
+            else
+                t1 = std::min(t1, t);
+            if (t0 > t1)
+                return false;
+        }
+        // 没被裁掉的端点保持原值不变
+        if (t1 < 1.0)
+            b = {a.x + t1 * dx, a.y + t1 * dy};
+        if (t0 > 0.0)
+            a = {a.x + t0 * dx, a.y + t0 * dy};
+        return true;
+    }
+}
+
+void stitchContours(const std::vector<PlotTile>& tiles, double tolerance, Contours& out)
+{
+    out.points.clear();
+    out.starts.assign(1, 0);
+    // 长度为零的线段单独处理: 落在其他线段上的丢掉, 孤立的保留为单点
+    std::vector<Segment> segments;
+    std::vector<long long> dots;
+    for (const PlotTile& tile : tiles)
+        for (const Segment& segment : tile.segments)
+            if (segment.x1 != segment.x2 || segment.y1 != segment.y2)
+                segments.push_back(segment);
+            else
+                dots.push_back(pointKey(segment.x1, segment.y1));
+
+    // 端点 2i 和 2i + 1 是第 i 条线段的两端; 相邻单元在共用边上的交点坐标相同, 按坐标排序后排在一起
+    auto point = [&](size_t end)
+    {
+        const Segment& segment = segments[end / 2];
+        return end % 2 ? SDL_Point{segment.x2, segment.y2} : SDL_Point{segment.x1, segment.y1};
+    };
+    std::vector<std::pair<long long, size_t>> ends(segments.size() * 2);
+    for (size_t end = 0; end < ends.size(); ++end)
+    {
+        const SDL_Point p = point(end);
+        ends[end] = {pointKey(p.x, p.y), end};
+    }
+    std::sort(ends.begin(), ends.end());
+    std::vector<size_t> slot(ends.size());
+    for (size_t k = 0; k < ends.size(); ++k)
+        slot[ends[k].second] = k;
+
+    std::vector<char> used(segments.size(), 0);
+    // 与端点 end 重合且所在线段未用过的端点, 没有时返回 size_max
+    auto follow = [&](size_t end)
+    {
+        const size_t k = slot[end];
+        const long long key = ends[k].first;
+        for (size_t j = k; j-- > 0 && ends[j].first == key;)
+            if (!used[ends[j].second / 2])
+                return ends[j].second;
+        for (size_t j = k + 1; j < ends.size() && ends[j].first == key; ++j)
+            if (!used[ends[j].second / 2])
+                return ends[j].second;
+        return eval::size_max;
+    };
+
+    std::vector<SDL_Point> forward;
+    std::vector<SDL_Point> line;
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        if (used[i])
+            continue;
+        used[i] = 1;
+        // 从线段两端分别向外延伸, 闭合曲线会在首端停下
+        line.clear();
+        for (size_t end = 2 * i, match; (match = follow(end)) != eval::size_max; end = match ^ 1)
+        {
+            used[match / 2] = 1;
+            line.push_back(point(match ^ 1));
+        }
+        std::reverse(line.begin(), line.end());
+        line.push_back(point(2 * i));
+        line.push_back(point(2 * i + 1));
+        forward.clear();
+        for (size_t end = 2 * i + 1, match; (match = follow(end)) != eval::size_max; end = match ^ 1)
+        {
+            used[match / 2] = 1;
+            forward.push_back(point(match ^ 1));
+        }
+        line.insert(line.end(), forward.begin(), forward.end());
+        simplify(line, tolerance, out.points);
+        out.starts.push_back(out.points.size());
+    }
+
+    std::sort(dots.begin(), dots.end());
+    dots.erase(std::unique(dots.begin(), dots.end()), dots.end());
+    for (long long key : dots)
+    {
+        const auto it = std::lower_bound(ends.begin(), ends.end(), std::make_pair(key, size_t{0}));
+        if (it != ends.end() && it->first == key)
+            continue;
+        const SDL_Point dot{static_cast<int>(key >> 32), static_cast<int>(key & 0xFFFFFFFF)};
+        out.points.insert(out.points.end(), {dot, dot});
+        out.starts.push_back(out.points.size());
+    }
+}
+
+EquationPlotter::Grid::Grid(int width, int height, size_t lstep, size_t ffts, size_t tileCells):
+    width(width),
+    height(height),
+    lstep(lstep),
+    ffts(ffts),
+    step(lstep * ffts),
+    tileCells(tileCells)
+{
+    place(0, 0);
+}
+
+void EquationPlotter::Grid::place(int x, int y)
+{
+    // 节点要覆盖到 [originX, width] x [originY, height] 的整个范围
+    const int s = static_cast<int>(step);
+    originX = x;
+    originY = y;
+    coarseRows = static_cast<size_t>((height - originY + s - 1) / s) + 1;
+    coarseCols = static_cast<size_t>((width - originX + s - 1) / s) + 1;
+    tilesY = (coarseRows + tileCells - 1) / tileCells;
+    tilesX = (coarseCols + tileCells - 1) / tileCells;
+    xColumn.resize(coarseCols);
+}
+
+int EquationPlotter::Grid::screenX(size_t fine) const
+{
+    return originX + static_cast<int>(fine * lstep);
+}
+
+int EquationPlotter::Grid::screenY(size_t fine) const
+{
+    return originY + static_cast<int>(fine * lstep);
+}
+
+EquationPlotter::EquationPlotter(int width, int height, size_t lstep, size_t ffts):
+    workers(pool.size()),
+    fullGrid(width, height, lstep, ffts, tileCells),
+    previewGrid(width, height, lstep * PREVIEW_SCALE, ffts, tileCells),
+    lstep(lstep),
+    ffts(ffts)
+{
+    layoutGrids(width, height);
+}
+
+void EquationPlotter::setDensity(size_t lstep, size_t ffts)
+{
+    this->lstep = std::max<size_t>(1, lstep);
+    this->ffts = std::max<size_t>(1, ffts);
+}
+
+void EquationPlotter::layoutGrids(int width, int height)
+{
+    fullGrid = Grid(width, height, lstep, ffts, tileCells);
+    previewGrid = Grid(width, height, lstep * PREVIEW_SCALE, ffts, tileCells);
+    // 尺寸向上取整到档位, 拖动改变窗口大小时只有跨过档位才重新分配采样缓存和着色缓冲
+    const int w = (width + SIZE_CLASS - 1) / SIZE_CLASS * SIZE_CLASS;
+    const int h = (height + SIZE_CLASS - 1) / SIZE_CLASS * SIZE_CLASS;
+    Grid largest(w, h, lstep, ffts, tileCells);
+    largest.place(1 - static_cast<int>(largest.step), 1 - static_cast<int>(largest.step));
+    nodeCapacity = ((largest.coarseRows - 1) * ffts + 1) * ((largest.coarseCols - 1) * ffts + 1);
+    if (w == classWidth && h == classHeight)
+        return;
+    classWidth = w;
+    classHeight = h;
+    coverage.clear();
+    reserveClass(coverage, static_cast<size_t>(w) * h);
+}
+
+void EquationPlotter::bind(const double* x, const double* y)
+{
+    xVar = x;
+    yVar = y;
+}
+
+void EquationPlotter::placeGrid(const MathRange& view)
+{
+    // 缩放比例不变且只平移了整数个像素时, 网格跟着内容移动, 旧节点在新视图中仍落在节点上
+    int x = 0;
+    int y = 0;
+    const bool sameX = std::abs(view.xSpan() - range.xSpan()) <= 1e-9 * std::abs(view.xSpan());
+    const bool sameY = std::abs(view.ySpan() - range.ySpan()) <= 1e-9 * std::abs(view.ySpan());
+    const bool sameSize = view.width == range.width && view.height == range.height;
+    if (sameX && sameY && sameSize)
+    {
+        const double shiftX = (range.xMin - view.xMin) / view.xSpan() * fullGrid.width;
+        const double shiftY = (view.yMax - range.yMax) / view.ySpan() * fullGrid.height;
+        const double roundX = std::round(shiftX);
+        const double roundY = std::round(shiftY);
+        const double limit = static_cast<double>(std::numeric_limits<int>::max() / 2);
+        if (std::abs(shiftX - roundX) < 1e-3 && std::abs(shiftY - roundY) < 1e-3 && std::abs(roundX) < limit && std::abs(roundY) < limit)
+        {
+            const int step = static_cast<int>(fullGrid.step);
+            x = (fullGrid.originX + static_cast<int>(roundX)) % step;
+            y = (fullGrid.originY + static_cast<int>(roundY)) % step;
+            x = x > 0 ? x - step : x;
+            y = y > 0 ? y - step : y;
+        }
+    }
+    fullGrid.place(x, y);
+}
+
+void EquationPlotter::seedCache(const Equation& eq, SampleCache& cache) const
+{
+    const Grid& grid = fullGrid;
+    const size_t rows = (grid.coarseRows - 1) * grid.ffts + 1;
+    const size_t cols = (grid.coarseCols - 1) * grid.ffts + 1;
+    const int lstep = static_cast<int>(grid.lstep);
+    const Point2D origin = screenToMath(grid.originX, grid.originY, range);
+    const Point2D unit = screenToMath(grid.originX + lstep, grid.originY + lstep, range);
+    const double dx = unit.x - origin.x;
+    const double dy = unit.y - origin.y;
+    const bool gradients = isContour(eq.type);
+
+    reserveClass(cache.seedValues, nodeCapacity);
+    reserveClass(cache.seedGradients, gradients ? nodeCapacity : 0);
+    cache.seedValues.assign(rows * cols, UNSAMPLED);
+    cache.seedGradients.assign(gradients ? rows * cols : 0, {UNSAMPLED});
+    if (cache.program == eq.program && !cache.values.empty())
+    {
+        // 新节点与旧节点重合时沿用旧值: 平移后只有新露出的条带需要求值, 缩放时只命中恰好重合的节点
+        auto match = [](double position, double origin, double delta, size_t count)
+        {
+            const double f = (position - origin) / delta;
+            const double k = std::round(f);
+            return std::abs(f - k) < 1e-6 && k >= 0 && k < static_cast<double>(count) ? static_cast<size_t>(k) : eval::size_max;
+        };
+        std::vector<size_t> mapX(cols);
+        for (size_t j = 0; j < cols; j++)
+            mapX[j] = match(origin.x + j * dx, cache.x0, cache.dx, cache.cols);
+        const bool copyGradients = gradients && cache.gradients.size() == cache.values.size();
+        for (size_t i = 0; i < rows; i++)
+        {
+            const size_t row = match(origin.y + i * dy, cache.y0, cache.dy, cache.rows);
+            if (row == eval::size_max)
+                continue;
+            for (size_t j = 0; j < cols; j++)
+            {
+                if (mapX[j] == eval::size_max)
+                    continue;
+                cache.seedValues[i * cols + j] = cache.values[row * cache.cols + mapX[j]];
+                if (copyGradients)
+                    cache.seedGradients[i * cols + j] = cache.gradients[row * cache.cols + mapX[j]];
+            }
+        }
+    }
+
+    cache.program = eq.program;
+    cache.x0 = origin.x;
+    cache.y0 = origin.y;
+    cache.dx = dx;
+    cache.dy = dy;
+    cache.rows = rows;
+    cache.cols = cols;
+    // 写回的目标先放入重映射的结果, 分帧补全中途放弃时, 没算到的区块仍保留旧的采样
+    reserveClass(cache.values, nodeCapacity);
+    reserveClass(cache.gradients, gradients ? nodeCapacity : 0);
+    cache.values = cache.seedValues;
+    cache.gradients = cache.seedGradients;
+}
+
+void EquationPlotter::loadCache(const SampleCache& cache, Worker& worker) const
+{
+    const Grid& grid = *worker.grid;
+    const size_t span = tileCells * grid.ffts + 1;
+    const size_t fy0 = worker.tileY * grid.ffts;
+    const size_t fx0 = worker.tileX * grid.ffts;
+    const size_t rows = std::min(span, cache.rows - fy0);
+    const size_t cols = std::min(span, cache.cols - fx0);
+    const bool gradients = !cache.seedGradients.empty();
+    for (size_t ly = 0; ly < rows; ly++)
+        for (size_t lx = 0; lx < cols; lx++)
+        {
+            const size_t node = (fy0 + ly) * cache.cols + fx0 + lx;
+            worker.fine[ly * span + lx] = cache.seedValues[node];
+            if (gradients)
+                worker.gradient[ly * span + lx] = cache.seedGradients[node];
+            if (ly % grid.ffts == 0 && lx % grid.ffts == 0)
+                coarseAt(worker, worker.tileY + ly / grid.ffts, worker.tileX + lx / grid.ffts) = cache.seedValues[node];
+        }
+}
+
+void EquationPlotter::storeCache(SampleCache& cache, Worker& worker) const
+{
+    // 区块只写回自己拥有的节点, 与相邻区块共享的右边和下边归下一个区块, 最后一行和一列除外
+    const Grid& grid = *worker.grid;
+    const size_t span = tileCells * grid.ffts + 1;
+    const size_t fy0 = worker.tileY * grid.ffts;
+    const size_t fx0 = worker.tileX * grid.ffts;
+    const size_t rows = std::min(span - 1, cache.rows - fy0);
+    const size_t cols = std::min(span - 1, cache.cols - fx0);
+    const bool gradients = !cache.gradients.empty();
+    for (size_t ly = 0; ly < rows; ly++)
+        for (size_t lx = 0; lx < cols; lx++)
+        {
+            const size_t node = (fy0 + ly) * cache.cols + fx0 + lx;
+            double value = worker.fine[ly * span + lx];
+            if (value == UNSAMPLED && ly % grid.ffts == 0 && lx % grid.ffts == 0)
+                value = coarseAt(worker, worker.tileY + ly / grid.ffts, worker.tileX + lx / grid.ffts);
+            cache.values[node] = value;
+            if (gradients)
+                cache.gradients[node] = worker.gradient[ly * span + lx];
+        }
+}
+
+double& EquationPlotter::coarseAt(Worker& worker, size_t cy, size_t cx) const
+{
+    return worker.coarse[(cy - worker.tileY) * (tileCells + 1) + cx - worker.tileX];
+}
+
+void EquationPlotter::sampleNodes(const Equation& eq, Worker& worker, size_t y0, size_t y1, size_t x0, size_t x1)
+{
+    const eval::program<double>& prog = *eq.program;
+    const Grid& grid = *worker.grid;
+    for (size_t cy = y0; cy < y1; cy++)
+    {
+        worker.context.set(prog, yVar, screenToMath(0, grid.screenY(cy * grid.ffts), range).y);
+        for (size_t cx = x0; cx < x1;)
+        {
+            if (coarseAt(worker, cy, cx) != UNSAMPLED)
+            {
+                cx++;
+                continue;
+            }
+            size_t end = cx + 1;
+            while (end < x1 && coarseAt(worker, cy, end) == UNSAMPLED)
+                end++;
+            const eval::column<double> xCol{xVar, &grid.xColumn[cx]};
+            Equation::evaluator.evaluate_batch(prog, worker.context, &xCol, 1, &coarseAt(worker, cy, cx), end - cx);
+            cx = end;
+        }
+    }
+}
+
+void EquationPlotter::cullBlock(const Equation& eq, PlotTile& tile, Worker& worker, size_t y0, size_t y1, size_t x0, size_t x1, bool fill)
+{
+    // 区块拥有节点 [y0, y1) x [x0, x1) 以及以这些节点为左上角的方格, 区间覆盖整个方格范围
+    const eval::program<double>& prog = *eq.program;
+    const Grid& grid = *worker.grid;
+    const Point2D a = screenToMath(grid.screenX(x0 * grid.ffts), grid.screenY(y0 * grid.ffts), range);
+    const Point2D b = screenToMath(grid.screenX(x1 * grid.ffts), grid.screenY(y1 * grid.ffts), range);
+    worker.bounds.set(prog, xVar, {std::min(a.x, b.x), std::max(a.x, b.x)});
+    worker.bounds.set(prog, yVar, {std::min(a.y, b.y), std::max(a.y, b.y)});
+    const eval::interval<double> v = Equation::evaluator.evaluate(prog, worker.bounds);
+
+    bool all = false;
+    bool contour = false;
+    if (v.is_empty())
+        fill = false;
+    else
+    {
+        switch (eq.type)
+        {
+        case RelationalOperator::NOT_EQUAL:
+            fill = fill && v.lo <= 1e16 && v.hi >= -1e16;
+            all = !v.partial && v.lo >= -1e16 && v.hi <= 1e16;
+            break;
+        case RelationalOperator::GREATER_THAN:
+        case RelationalOperator::GREATER_THAN_OR_EQUAL:
+            fill = fill && v.hi > 0;
+            all = !v.partial && v.lo > 0;
+            break;
+        case RelationalOperator::LESS_THAN:
+        case RelationalOperator::LESS_THAN_OR_EQUAL:
+            fill = fill && v.lo < 0;
+            all = !v.partial && v.hi < 0;
+            break;
+        default:
+            break;
+        }
+        if (isContour(eq.type))
+            contour = v.lo < 0 && v.hi >= 0;
+    }
+
+    // 区间已经证明区块内全部满足不等式, 无需采样
+    if (fill && all)
+    {
+        const int step = static_cast<int>(grid.step);
+        for (size_t cy = y0; cy < y1; cy++)
+            pushFill(tile, grid, grid.screenX(x0 * grid.ffts), grid.screenY(cy * grid.ffts), static_cast<int>(x1 - x0) * step, step);
+        fill = false;
+    }
+    if (!fill && !contour)
+        return;
+
+    if ((y1 - y0) * (x1 - x0) <= LEAF_NODES)
+    {
+        extractBlock(eq, tile, worker, y0, y1, x0, x1, fill, contour);
+        return;
+    }
+    const size_t ym = y1 - y0 > 1 ? (y0 + y1) / 2 : y1;
+    const size_t xm = x1 - x0 > 1 ? (x0 + x1) / 2 : x1;
+    cullBlock(eq, tile, worker, y0, ym, x0, xm, fill);
+    if (xm < x1)
+        cullBlock(eq, tile, worker, y0, ym, xm, x1, fill);
+    if (ym < y1)
+    {
+        cullBlock(eq, tile, worker, ym, y1, x0, xm, fill);
+        if (xm < x1)
+            cullBlock(eq, tile, worker, ym, y1, xm, x1, fill);
+    }
+}
+
+void EquationPlotter::pushFill(PlotTile& tile, const Grid& grid, int x, int y, int w, int h) const
+{
+    if (x < 0)
+    {
+        w += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        h += y;
+        y = 0;
+    }
+    w = std::min(w, grid.width - x);
+    h = std::min(h, grid.height - y);
+    if (w <= 0 || h <= 0)
+        return;
+    if (!tile.fills.empty())
+    {
+        SDL_Rect& last = tile.fills.back();
+        if (last.y == y && last.h == h && last.x + last.w == x)
+        {
+            last.w += w;
+            return;
+        }
+    }
+    tile.fills.push_back({x, y, w, h});
+}
+
+void EquationPlotter::fillBlock(const Equation& eq, PlotTile& tile, Worker& worker, size_t y0, size_t y1, size_t x0, size_t x1)
+{
+    // 四角都在区域内的方格整格填充, 部分在内的方格按双线性插值的符号逐行生成像素段
+    const Grid& grid = *worker.grid;
+    const int step = static_cast<int>(grid.step);
+    for (size_t cy = y0; cy < y1; cy++)
+    {
+        const size_t ny = std::min(cy + 1, grid.coarseRows - 1);
+        for (size_t cx = x0; cx < x1; cx++)
+        {
+            const size_t nx = std::min(cx + 1, grid.coarseCols - 1);
+            const double s[4] = {
+                insideness(eq.type, coarseAt(worker, cy, cx)), insideness(eq.type, coarseAt(worker, cy, nx)),
+                insideness(eq.type, coarseAt(worker, ny, cx)), insideness(eq.type, coarseAt(worker, ny, nx))};
+            const int count = (s[0] > 0) + (s[1] > 0) + (s[2] > 0) + (s[3] > 0);
+            const int px = grid.screenX(cx * grid.ffts);
+            const int py = grid.screenY(cy * grid.ffts);
+            if (count == 4)
+                pushFill(tile, grid, px, py, step, step);
+            if (count == 0 || count == 4)
+                continue;
+
+            const bool finite = std::isfinite(s[0]) && std::isfinite(s[1]) && std::isfinite(s[2]) && std::isfinite(s[3]);
+            for (int j = 0; j < step; j++)
+            {
+                const double v = static_cast<double>(j) / step;
+                int start = -1;
+                for (int i = 0; i <= step; i++)
+                {
+                    bool inside = false;
+                    if (i < step)
+                    {
+                        const double u = static_cast<double>(i) / step;
+                        // 含无穷或无定义的方格退化为取最近的角
+                        if (finite)
+                            inside = (1 - v) * ((1 - u) * s[0] + u * s[1]) + v * ((1 - u) * s[2] + u * s[3]) > 0;
+                        else
+                            inside = s[(2 * j >= step ? 2 : 0) + (2 * i >= step ? 1 : 0)] > 0;
+                    }
+                    if (inside && start < 0)
+                        start = i;
+                    else if (!inside && start >= 0)
+                    {
+                        pushFill(tile, grid, px + start, py + j, i - start, 1);
+                        start = -1;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void EquationPlotter::extractBlock(const Equation& eq, PlotTile& tile, Worker& worker, size_t y0, size_t y1, size_t x0, size_t x1, bool fill, bool contour)
+{
+    const Grid& grid = *worker.grid;
+    const size_t ffts = grid.ffts;
+    const size_t lstep = grid.lstep;
+    const size_t ye = std::min(y1, grid.coarseRows - 1);
+    const size_t xe = std::min(x1, grid.coarseCols - 1);
+    sampleNodes(eq, worker, y0, ye + 1, x0, xe + 1);
+
+    if (fill)
+        fillBlock(eq, tile, worker, y0, y1, x0, x1);
+
+    if (!contour)
+        return;
+
+    const eval::program<double>& prog = *eq.program;
+    const size_t span = tileCells * ffts + 1;
+    const int cell = static_cast<int>(lstep);
+
+    for (size_t cy = y0; cy < ye; cy++)
+    {
+        for (size_t cx = x0; cx < xe; cx++)
+        {
+            const double v11 = coarseAt(worker, cy, cx);
+            const double v12 = coarseAt(worker, cy, cx + 1);
+            const double v21 = coarseAt(worker, cy + 1, cx);
+            const double v22 = coarseAt(worker, cy + 1, cx + 1);
+            const char state =
+                ((v11 >= 0) ? 1 : 0) |
+                ((v12 >= 0) ? 2 : 0) |
+                ((v21 >= 0) ? 4 : 0) |
+                ((v22 >= 0) ? 8 : 0);
+
+            if (state == 0 || state == 0b1111)
+                continue;
+
+            for (size_t i = 0; i <= ffts; i++)
+            {
+                const size_t ly = (cy - worker.tileY) * ffts + i;
+                const int sy = grid.screenY(cy * ffts + i);
+                for (size_t j = 0; j <= ffts; j++)
+                {
+                    const size_t lx = (cx - worker.tileX) * ffts + j;
+                    const int sx = grid.screenX(cx * ffts + j);
+                    double& value = worker.fine[ly * span + lx];
+                    if (value == UNSAMPLED)
+                    {
+                        if (i % ffts == 0 && j % ffts == 0)
+                            value = coarseAt(worker, cy + i / ffts, cx + j / ffts);
+                        else
+                        {
+                            const Point2D p = screenToMath(sx, sy, range);
+                            worker.context.set(prog, xVar, p.x);
+                            worker.context.set(prog, yVar, p.y);
+                            value = Equation::evaluator.evaluate(prog, worker.context);
+                        }
+                    }
+                    if (i && j)
+                    {
+                        const double* above = &worker.fine[(ly - 1) * span + lx];
+                        const double* here = &worker.fine[ly * span + lx];
+                        marchingSquares(tile.segments, sx - cell, sy - cell, cell, above[-1], above[0], here[-1], here[0]);
+                        worker.crossing[(ly - 1) * (span - 1) + lx - 1] = crosses(above[-1], above[0], here[-1], here[0]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+const eval::dual<double>& EquationPlotter::gradientAt(const Equation& eq, Worker& worker, size_t ly, size_t lx)
+{
+    const Grid& grid = *worker.grid;
+    eval::dual<double>& node = worker.gradient[ly * (tileCells * grid.ffts + 1) + lx];
+    if (node.value == UNSAMPLED)
+    {
+        const eval::program<double>& prog = *eq.program;
+        const Point2D p = screenToMath(grid.screenX(worker.tileX * grid.ffts + lx), grid.screenY(worker.tileY * grid.ffts + ly), range);
+        worker.duals.set(prog, xVar, {p.x, 1.0, 0.0});
+        worker.duals.set(prog, yVar, {p.y, 0.0, 1.0});
+        node = Equation::evaluator.evaluate(prog, worker.duals);
+    }
+    return node;
+}
+
+bool EquationPlotter::cellCorners(const Equation& eq, Worker& worker, size_t ly, size_t lx, double scaleX, double scaleY, eval::dual<double> (&corner)[4])
+{
+    corner[0] = gradientAt(eq, worker, ly, lx);
+    corner[1] = gradientAt(eq, worker, ly, lx + 1);
+    corner[2] = gradientAt(eq, worker, ly + 1, lx);
+    corner[3] = gradientAt(eq, worker, ly + 1, lx + 1);
+    for (eval::dual<double>& c : corner)
+    {
+        // 梯度换算为每像素的变化量
+        c.dx *= scaleX;
+        c.dy *= scaleY;
+        if (isundef(c.value) || isundef(c.dx) || isundef(c.dy))
+            return false;
+    }
+    return !isPole(corner[0].value, corner[1].value, corner[0].dx, corner[1].dx) &&
+        !isPole(corner[2].value, corner[3].value, corner[2].dx, corner[3].dx) &&
+        !isPole(corner[0].value, corner[2].value, corner[0].dy, corner[2].dy) &&
+        !isPole(corner[1].value, corner[3].value, corner[1].dy, corner[3].dy);
+}
+
+void EquationPlotter::shadeTile(const Equation& eq, PlotTile& tile, Worker& worker)
+{
+    // 在曲线经过的细方格及其相邻方格内逐像素着色: 四角的对偶数各给出一个切平面,
+    // 按双线性权重混合后的 |f| / |∇f| 即像素到曲线的距离估计, 线宽因此与缩放和函数陡峭程度无关
+    const Grid& grid = *worker.grid;
+    const size_t cells = tileCells * grid.ffts;
+    const size_t rows = std::min(cells, (grid.coarseRows - 1 - worker.tileY) * grid.ffts);
+    const size_t cols = std::min(cells, (grid.coarseCols - 1 - worker.tileX) * grid.ffts);
+    const int lstep = static_cast<int>(grid.lstep);
+
+    // 每个像素对应的数学坐标增量
+    const Point2D origin = screenToMath(0, 0, range);
+    const Point2D unit = screenToMath(1, 1, range);
+    const double scaleX = unit.x - origin.x;
+    const double scaleY = unit.y - origin.y;
+
+    if (std::find(worker.crossing.begin(), worker.crossing.end(), 1) == worker.crossing.end())
+        return;
+    worker.duals.reset(*eq.program);
+
+    // 跨过极点的方格不算曲线经过, 其余曲线经过的方格向四周扩展一格, 覆盖线宽溢出到相邻方格的部分
+    eval::dual<double> corner[4];
+    for (size_t ly = 0; ly < rows; ly++)
+        for (size_t lx = 0; lx < cols; lx++)
+        {
+            char& crossing = worker.crossing[ly * cells + lx];
+            if (crossing == 1 && !cellCorners(eq, worker, ly, lx, scaleX, scaleY, corner))
+                crossing = 0;
+        }
+    for (size_t ly = 0; ly < rows; ly++)
+        for (size_t lx = 0; lx < cols; lx++)
+        {
+            if (worker.crossing[ly * cells + lx] != 1)
+                continue;
+            for (size_t ny = ly ? ly - 1 : 0; ny <= std::min(ly + 1, rows - 1); ny++)
+                for (size_t nx = lx ? lx - 1 : 0; nx <= std::min(lx + 1, cols - 1); nx++)
+                    if (!worker.crossing[ny * cells + nx])
+                        worker.crossing[ny * cells + nx] = 2;
+        }
+
+    for (size_t ly = 0; ly < rows; ly++)
+    {
+        for (size_t lx = 0; lx < cols; lx++)
+        {
+            if (!worker.crossing[ly * cells + lx] || !cellCorners(eq, worker, ly, lx, scaleX, scaleY, corner))
+                continue;
+
+            const double reach = Constants::CURVE_RADIUS + 0.5;
+            double slope[4];
+            bool distant = corner[0].value != 0;
+            for (int k = 0; k < 4; k++)
+            {
+                slope[k] = std::hypot(corner[k].dx, corner[k].dy);
+                distant = distant && (corner[k].value > 0) == (corner[0].value > 0) && std::abs(corner[k].value) > (reach + lstep * 0.7072) * slope[k];
+            }
+            // 四角到曲线的距离都超过半条对角线加线宽时整格都不会被覆盖
+            if (distant)
+                continue;
+
+            const int px = grid.screenX(worker.tileX * grid.ffts + lx);
+            const int py = grid.screenY(worker.tileY * grid.ffts + ly);
+            for (int j = 0; j < lstep; j++)
+            {
+                const double v = static_cast<double>(j) / lstep;
+                // 上下两条边上的切平面值, 沿 i 方向都是线性的
+                const double top0 = corner[0].value + corner[0].dy * j;
+                const double top1 = corner[1].value + corner[1].dy * j - corner[1].dx * lstep;
+                const double bottom0 = corner[2].value + corner[2].dy * (j - lstep);
+                const double bottom1 = corner[3].value + corner[3].dy * (j - lstep) - corner[3].dx * lstep;
+                const double left = (1 - v) * slope[0] + v * slope[2];
+                const double right = (1 - v) * slope[1] + v * slope[3];
+                for (int i = 0; i < lstep; i++)
+                {
+                    const double u = static_cast<double>(i) / lstep;
+                    const double top = (1 - u) * (top0 + corner[0].dx * i) + u * (top1 + corner[1].dx * i);
+                    const double bottom = (1 - u) * (bottom0 + corner[2].dx * i) + u * (bottom1 + corner[3].dx * i);
+                    const double value = std::abs((1 - v) * top + v * bottom);
+                    const double norm = (1 - u) * left + u * right;
+                    if (!(value < reach * norm))
+                        continue;
+                    const int level = static_cast<int>(std::min(1.0, reach - value / norm) * Constants::SHADE_LEVELS + 0.5);
+                    if (level > 0)
+                        tile.shades[level - 1].push_back({px + i, py + j});
+                }
+            }
+        }
+    }
+}
+
+void EquationPlotter::plotTile(const Equation& eq, const Grid& grid, PlotTile& tile, size_t index, Worker& worker, SampleCache* cache)
+{
+    worker.grid = &grid;
+    worker.tileY = index / grid.tilesX * tileCells;
+    worker.tileX = index % grid.tilesX * tileCells;
+    const size_t cy1 = std::min(worker.tileY + tileCells, grid.coarseRows);
+    const size_t cx1 = std::min(worker.tileX + tileCells, grid.coarseCols);
+
+    tile.fills.clear();
+    tile.segments.clear();
+    tile.sampleTime = 0.0;
+    tile.contourTime = 0.0;
+    tile.samples = (cy1 - worker.tileY) * (cx1 - worker.tileX) * grid.ffts * grid.ffts;
+    for (std::vector<SDL_Point>& shade : tile.shades)
+        shade.clear();
+
+    const eval::program<double>& prog = *eq.program;
+    worker.context.reset(prog);
+    worker.bounds.reset(prog);
+    worker.coarse.assign((tileCells + 1) * (tileCells + 1), UNSAMPLED);
+    const size_t span = tileCells * grid.ffts + 1;
+    worker.fine.assign(span * span, UNSAMPLED);
+    worker.gradient.assign(span * span, {UNSAMPLED});
+    worker.crossing.assign((span - 1) * (span - 1), 0);
+    if (cache)
+        loadCache(*cache, worker);
+
+    const auto start = std::chrono::steady_clock::now();
+    cullBlock(eq, tile, worker, worker.tileY, cy1, worker.tileX, cx1, eq.type != RelationalOperator::EQUAL);
+    const auto sampled = std::chrono::steady_clock::now();
+    // 预览只画折线, 完整精度下曲线改为逐像素的抗锯齿着色
+    if (&grid == &fullGrid && isContour(eq.type))
+        shadeTile(eq, tile, worker);
+    if (cache)
+        storeCache(*cache, worker);
+    tile.sampleTime = std::chrono::duration<double, std::milli>(sampled - start).count();
+    tile.contourTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sampled).count();
+}
+
+void EquationPlotter::runJobs(const std::vector<Equation>& equations, std::vector<Job>& jobs)
+{
+    size_t total = 0;
+    for (Job& job : jobs)
+    {
+        job.first = total;
+        job.failed = false;
+        total += job.count;
+    }
+    if (!total)
+        return;
+
+    std::unique_ptr<std::atomic<bool>[]> failed(new std::atomic<bool>[jobs.size()]);
+    for (size_t j = 0; j < jobs.size(); ++j)
+    {
+        failed[j] = false;
+        jobs[j].error.clear();
+    }
+
+    pool.parallelFor(total, [&](size_t index, size_t worker)
+    {
+        const size_t j = std::upper_bound(jobs.begin(), jobs.end(), index, [](size_t value, const Job& job)
+        {
+            return value < job.first;
+        }) - jobs.begin() - 1;
+        if (failed[j])
+            return;
+        try
+        {
+            const Job& job = jobs[j];
+            const size_t tile = job.begin + index - job.first;
+            plotTile(equations[job.equation], *job.grid, (*job.tiles)[tile], tile, workers[worker], job.cache);
+        }
+        catch (const std::exception& e)
+        {
+            // 只有第一个失败的区块写入原因
+            if (!failed[j].exchange(true))
+                jobs[j].error = e.what();
+        }
+        catch (...)
+        {
+            if (!failed[j].exchange(true))
+                jobs[j].error = "unknown error";
+        }
+    });
+
+    for (size_t j = 0; j < jobs.size(); ++j)
+        jobs[j].failed = failed[j];
+}
+
+void EquationPlotter::plotExplicit(const Equation& eq, PlotResult& result)
+{
+    // 自变量 t 沿屏幕的一个轴逐像素取值, 函数值 s 换算成另一个轴上的屏幕坐标
+    const auto start = std::chrono::steady_clock::now();
+    const eval::program<double>& prog = *eq.function;
+    eval::context<double>& context = workers.front().context;
+    context.reset(prog);
+    const bool vertical = eq.form == ExplicitForm::X_OF_Y;
+    const double* var = vertical ? yVar : xVar;
+    const double width = fullGrid.width;
+    const double height = fullGrid.height;
+    const double extent = vertical ? height : width;
+    const double across = vertical ? width : height;
+    auto toMath = [&](double t)
+    {
+        return vertical ? range.yMax - t * range.ySpan() / height : range.xMin + t * range.xSpan() / width;
+    };
+    auto toScreen = [&](double v)
+    {
+        const double s = vertical ? (v - range.xMin) / range.xSpan() * width : (range.yMax - v) / range.ySpan() * height;
+        return std::isfinite(s) ? s : std::numeric_limits<double>::quiet_NaN();
+    };
+    size_t samples = 0;
+    auto sample = [&](double t)
+    {
+        samples++;
+        context.set(prog, var, toMath(t));
+        return toScreen(Equation::evaluator.evaluate(prog, context));
+    };
+    auto point = [&](double t, double s)
+    {
+        return vertical ? Point2D{s, t} : Point2D{t, s};
+    };
+
+    // 每个像素列 (行) 先取一个值, 两侧各多取一个
+    const size_t count = static_cast<size_t>(extent) + 3;
+    samples += count;
+    std::vector<double> params(count);
+    std::vector<double> values(count);
+    for (size_t k = 0; k < count; k++)
+        params[k] = toMath(static_cast<double>(k) - 1);
+    const eval::column<double> column{var, params.data()};
+    Equation::evaluator.evaluate_batch(prog, context, &column, 1, values.data(), count);
+
+    std::vector<std::vector<Point2D>> lines(1);
+    auto breakLine = [&]()
+    {
+        if (lines.back().size() > 1)
+            lines.emplace_back();
+        else
+            lines.back().clear();
+    };
+    // 远在屏幕外的函数值只关心在哪一侧, 截到屏幕外一圈后再判断是否需要细分
+    const double reach = Constants::CURVE_RADIUS + 0.5;
+    const double lo = -reach - 1.0;
+    const double hi = across + reach + 1.0;
+    auto refine = [&](auto& self, double a, double fa, double b, double fb, int level) -> void
+    {
+        const bool da = !std::isnan(fa);
+        const bool db = !std::isnan(fb);
+        if (!da && !db)
+            return;
+        const double ca = std::clamp(fa, lo, hi);
+        const double cb = std::clamp(fb, lo, hi);
+        if (da && db && ca == cb && (ca == lo || ca == hi))
+        {
+            lines.back().push_back(point(b, fb));
+            return;
+        }
+        const double m = (a + b) / 2;
+        const double fm = sample(m);
+        if (da && db && !std::isnan(fm))
+        {
+            const double cm = std::clamp(fm, lo, hi);
+            if (std::abs(cb - ca) <= EXPLICIT_SPAN && std::abs(cm - (ca + cb) / 2) <= EXPLICIT_FLATNESS)
+            {
+                lines.back().push_back(point(b, fb));
+                return;
+            }
+            if (level == EXPLICIT_DEPTH)
+            {
+                // 细分到底仍有跳变时, 中点落在两端之间说明函数只是很陡, 否则是极点或跳跃间断
+                const double ratio = (fm - fa) / (fb - fa);
+                if (std::abs(cb - ca) > 1.0 && !(ratio > 0.1 && ratio < 0.9))
+                    breakLine();
+                lines.back().push_back(point(b, fb));
+                return;
+            }
+        }
+        else if (level == EXPLICIT_DEPTH)
+        {
+            // 定义域的边界
+            breakLine();
+            if (db)
+                lines.back().push_back(point(b, fb));
+            return;
+        }
+        self(self, a, fa, m, fm, level + 1);
+        self(self, m, fm, b, fb, level + 1);
+    };
+
+    double previous = toScreen(values[0]);
+    if (!std::isnan(previous))
+        lines.back().push_back(point(-1.0, previous));
+    for (size_t k = 1; k < count; k++)
+    {
+        const double current = toScreen(values[k]);
+        refine(refine, static_cast<double>(k) - 2, previous, static_cast<double>(k) - 1, current, 0);
+        previous = current;
+    }
+    breakLine();
+    const auto sampled = std::chrono::steady_clock::now();
+    result.sampleTime = std::chrono::duration<double, std::milli>(sampled - start).count();
+
+    // 裁剪到屏幕后按到折线的距离逐像素着色, 与隐式曲线的线宽和灰度分级一致
+    PlotTile tile;
+    const int columns = fullGrid.width;
+    const int rows = fullGrid.height;
+    coverage.resize(static_cast<size_t>(columns) * rows);
+    std::vector<int> covered;
+    std::vector<SDL_Point> contour;
+    Contours& contours = result.contours;
+    contours.points.clear();
+    contours.starts.assign(1, 0);
+    auto flushContour = [&]()
+    {
+        if (contour.size() > 1)
+        {
+            simplify(contour, Constants::CONTOUR_TOLERANCE, contours.points);
+            contours.starts.push_back(contours.points.size());
+        }
+        contour.clear();
+    };
+    for (const std::vector<Point2D>& line : lines)
+    {
+        for (size_t k = 1; k < line.size(); k++)
+        {
+            Point2D a = line[k - 1];
+            Point2D b = line[k];
+            if (!clipSegment(a, b, -reach, -reach, width + reach, height + reach))
+            {
+                flushContour();
+                continue;
+            }
+            const double dx = b.x - a.x;
+            const double dy = b.y - a.y;
+            const double length2 = dx * dx + dy * dy;
+            const int x0 = std::max(0, static_cast<int>(std::floor(std::min(a.x, b.x) - reach)));
+            const int x1 = std::min(columns - 1, static_cast<int>(std::ceil(std::max(a.x, b.x) + reach)));
+            const int y0 = std::max(0, static_cast<int>(std::floor(std::min(a.y, b.y) - reach)));
+            const int y1 = std::min(rows - 1, static_cast<int>(std::ceil(std::max(a.y, b.y) + reach)));
+            for (int y = y0; y <= y1; y++)
+                for (int x = x0; x <= x1; x++)
+                {
+                    const double px = x - a.x;
+                    const double py = y - a.y;
+                    const double t = length2 > 0 ? std::clamp((px * dx + py * dy) / length2, 0.0, 1.0) : 0.0;
+                    const double ex = px - t * dx;
+                    const double ey = py - t * dy;
+                    if (!(ex * ex + ey * ey < reach * reach))
+                        continue;
+                    // 多段折线经过同一像素时取覆盖率最大的一级
+                    const int level = static_cast<int>(std::min(1.0, reach - std::sqrt(ex * ex + ey * ey)) * Constants::SHADE_LEVELS + 0.5);
+                    Uint8& cell = coverage[static_cast<size_t>(y) * columns + x];
+                    if (level > 0 && !cell)
+                        covered.push_back(y * columns + x);
+                    cell = static_cast<Uint8>(std::max<int>(cell, level));
+                }
+
+            const SDL_Point pa{static_cast<int>(std::lround(a.x)), static_cast<int>(std::lround(a.y))};
+            const SDL_Point pb{static_cast<int>(std::lround(b.x)), static_cast<int>(std::lround(b.y))};
+            if (contour.empty())
+                contour.push_back(pa);
+            contour.push_back(pb);
+            // 终点被裁掉说明曲线从这里离开屏幕
+            if (b.x != line[k].x || b.y != line[k].y)
+                flushContour();
+        }
+        flushContour();
+    }
+
+    for (int pixel : covered)
+    {
+        Uint8& cell = coverage[pixel];
+        tile.shades[cell - 1].push_back({pixel % columns, pixel / columns});
+        cell = 0;
+    }
+    result.tiles.clear();
+    result.tiles.push_back(std::move(tile));
+    result.contourTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sampled).count();
+    updateCost(result, eq.program, result.sampleTime + result.contourTime, samples);
+}
+
+bool EquationPlotter::plot(const std::vector<Equation>& equations, const MathRange& view, std::vector<PlotResult>& results, const PlotSchedule& schedule)
+{
+    const double budget = schedule.budget;
+    const auto start = std::chrono::steady_clock::now();
+    results.resize(equations.size());
+    if (view.width != fullGrid.width || view.height != fullGrid.height || lstep != fullGrid.lstep || ffts != fullGrid.ffts)
+    {
+        // 网格变了, 已有的结果和补全进度都作废; 采样缓存按数学坐标重映射, 仍可沿用
+        layoutGrids(view.width, view.height);
+        for (PlotResult& result : results)
+        {
+            result.program.reset();
+            result.refinement.active = false;
+        }
+    }
+    placeGrid(view);
+    range = view;
+    for (Grid* grid : {&fullGrid, &previewGrid})
+        for (size_t cx = 0; cx < grid->coarseCols; cx++)
+            grid->xColumn[cx] = screenToMath(grid->screenX(cx * grid->ffts), 0, range).x;
+
+    std::vector<Job> coarse;
+    std::vector<size_t> refining;
+    auto showCoarse = [&](size_t i)
+    {
+        const Equation& eq = equations[i];
+        PlotResult& result = results[i];
+        result.program = eq.program;
+        result.type = eq.type;
+        result.range = view;
+        result.preview = true;
+        result.shaded = false;
+        result.failed = false;
+        result.error.clear();
+        result.revision++;
+        result.tiles.resize(previewGrid.tilesX * previewGrid.tilesY);
+        coarse.push_back({i, &previewGrid, &result.tiles, nullptr, 0, result.tiles.size(), 0, false});
+    };
+
+    // 把一批区块的耗时记到所属的方程上, 并更新每个采样点的平均耗时
+    auto account = [&](const Job& job)
+    {
+        PlotResult& result = results[job.equation];
+        double time = 0.0;
+        size_t samples = 0;
+        for (size_t t = job.begin; t < job.begin + job.count; ++t)
+        {
+            const PlotTile& tile = (*job.tiles)[t];
+            result.sampleTime += tile.sampleTime;
+            result.contourTime += tile.contourTime;
+            time += tile.sampleTime + tile.contourTime;
+            samples += tile.samples;
+        }
+        if (!job.failed)
+            updateCost(result, equations[job.equation].program, time, samples);
+    };
+
+    for (PlotResult& result : results)
+    {
+        result.sampleTime = 0.0;
+        result.contourTime = 0.0;
+    }
+    for (size_t i = 0; i < equations.size(); ++i)
+    {
+        const Equation& eq = equations[i];
+        PlotResult& result = results[i];
+        PlotRefinement& refinement = result.refinement;
+        if (!eq.shown || eq.type == RelationalOperator::INVALID || !eq.program)
+        {
+            result.tiles.clear();
+            result.contours = {};
+            result.program.reset();
+            result.failed = false;
+            result.error.clear();
+            refinement.active = false;
+            continue;
+        }
+        const bool current = result.program == eq.program && result.type == eq.type && result.range == view;
+        if (current && (!result.preview || i == schedule.preview))
+            continue;
+        if (eq.form != ExplicitForm::NONE && eq.type == RelationalOperator::EQUAL && eq.function)
+        {
+            // 显式方程按列一维采样, 代价很低, 编辑中也直接画完整精度
+            refinement.active = false;
+            result.program = eq.program;
+            result.type = eq.type;
+            result.range = view;
+            result.preview = false;
+            result.shaded = true;
+            result.revision++;
+            result.failed = true;
+            try
+            {
+                plotExplicit(eq, result);
+                result.failed = false;
+                result.error.clear();
+            }
+            catch (const std::exception& e)
+            {
+                result.error = e.what();
+            }
+            catch (...)
+            {
+                result.error = "unknown error";
+            }
+            if (result.failed)
+            {
+                result.tiles.clear();
+                result.contours = {};
+            }
+            continue;
+        }
+        if (i == schedule.preview)
+        {
+            // 正在编辑的方程只画粗网格, 停止输入后才补全
+            refinement.active = false;
+            showCoarse(i);
+            continue;
+        }
+        if (!refinement.active || refinement.program != eq.program || refinement.type != eq.type || !(refinement.range == view))
+        {
+            refinement.active = true;
+            refinement.next = 0;
+            refinement.program = eq.program;
+            refinement.type = eq.type;
+            refinement.range = view;
+            refinement.tiles.resize(fullGrid.tilesX * fullGrid.tilesY);
+            seedCache(eq, result.cache);
+        }
+        refining.push_back(i);
+    }
+
+    // 一小批一小批地补全区块, 超出时间预算就停下, 每批的耗时决定了超出预算的上限.
+    // 选中的方程最先, 其余按预计剩余耗时从少到多, 便宜的方程先画完; 预计剩余耗时超过 DEGRADE_BUDGETS 个预算的方程
+    // 先显示粗网格, 其余方程都补完后才继续. 还没测过耗时的方程按 0 计, 补完第一批后就有了估计
+    const size_t batch = std::isfinite(budget) ? std::max<size_t>(1, workers.size()) * 2 : eval::size_max;
+    const double tileSamples = static_cast<double>(tileCells * fullGrid.ffts * tileCells * fullGrid.ffts);
+    auto remaining = [&](size_t i)
+    {
+        // 耗时是别的程序测出来的 (方程刚重新编译) 时也按没测过计
+        const PlotResult& result = results[i];
+        const double cost = result.costProgram == equations[i].program ? result.cost : 0.0;
+        return cost * tileSamples * static_cast<double>(result.refinement.tiles.size() - result.refinement.next) / 1e6;
+    };
+    auto elapsed = [&]()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    while (elapsed() < budget)
+    {
+        std::vector<std::pair<double, size_t>> order;
+        bool urgent = false;
+        for (size_t i : refining)
+        {
+            if (!results[i].refinement.active)
+                continue;
+            const double cost = i == schedule.focus ? -1.0 : remaining(i);
+            order.push_back({cost, i});
+            urgent = urgent || cost <= DEGRADE_BUDGETS * budget;
+        }
+        std::sort(order.begin(), order.end());
+
+        std::vector<Job> jobs;
+        size_t taken = 0;
+        for (const auto& [cost, i] : order)
+        {
+            if (urgent && cost > DEGRADE_BUDGETS * budget)
+                break;
+            PlotRefinement& refinement = results[i].refinement;
+            const size_t count = std::min(batch - taken, refinement.tiles.size() - refinement.next);
+            jobs.push_back({i, &fullGrid, &refinement.tiles, &results[i].cache, refinement.next, count, 0, false});
+            taken += count;
+            if (taken == batch)
+                break;
+        }
+        if (jobs.empty())
+            break;
+        runJobs(equations, jobs);
+
+        for (const Job& job : jobs)
+        {
+            account(job);
+            PlotResult& result = results[job.equation];
+            PlotRefinement& refinement = result.refinement;
+            refinement.next += job.count;
+            if (refinement.next < refinement.tiles.size() && !job.failed)
+                continue;
+            result.tiles.swap(refinement.tiles);
+            result.program = refinement.program;
+            result.type = refinement.type;
+            result.range = refinement.range;
+            result.preview = false;
+            result.shaded = isContour(result.type);
+            result.failed = job.failed;
+            result.error = job.error;
+            result.revision++;
+            result.contours = {};
+            refinement.active = false;
+            // 中途失败的区块没有写回, 缓存不完整
+            if (job.failed)
+                result.cache.program.reset();
+        }
+    }
+
+    // 预算内没有补完的方程先用粗网格顶上, 或者保留同一方程在旧视图下的结果
+    bool finished = true;
+    for (size_t i : refining)
+    {
+        const PlotResult& result = results[i];
+        if (!result.refinement.active)
+            continue;
+        finished = false;
+        const bool same = result.program == equations[i].program && result.type == equations[i].type;
+        if (!(same && result.range == view) && !(same && schedule.keepStale))
+            showCoarse(i);
+    }
+    runJobs(equations, coarse);
+    for (const Job& job : coarse)
+    {
+        account(job);
+        PlotResult& result = results[job.equation];
+        // 完整精度的曲线按像素着色, 只有预览需要画折线
+        const auto stitching = std::chrono::steady_clock::now();
+        stitchContours(result.tiles, Constants::CONTOUR_TOLERANCE, result.contours);
+        result.contourTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stitching).count();
+        if (job.failed)
+        {
+            result.failed = true;
+            result.error = job.error;
+            result.refinement.active = false;
+        }
+    }
+    return finished;
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include "Equation.hpp"
+#include "MathUtils.hpp"
+#include "ThreadPool.hpp"
+#include "Constants.hpp"
+#include <array>
+#include <limits>
+#include <vector>
+
+struct Segment
+{
+    int x1, y1, x2, y2;
+};
+
+struct PlotTile
+{
+    // 不等式区域, 按像素行合并的矩形, 互不重叠
+    std::vector<SDL_Rect> fills;
+    std::vector<Segment> segments;
+    // 按覆盖率分级的抗锯齿曲线像素, shades[i] 的不透明度为 (i + 1) / SHADE_LEVELS
+    std::array<std::vector<SDL_Point>, Constants::SHADE_LEVELS> shades;
+    // 计算本区块的耗时 (毫秒): 采样与区域提取, 以及抗锯齿曲线着色
+    double sampleTime = 0.0;
+    double contourTime = 0.0;
+    // 本区块覆盖的细网格节点数
+    size_t samples = 0;
+};
+
+// 由区块线段拼接并化简得到的折线, 第 i 条折线的顶点为 points[starts[i], starts[i + 1])
+struct Contours
+{
+    std::vector<SDL_Point> points;
+    std::vector<size_t> starts;
+
+    size_t size() const { return starts.empty() ? 0 : starts.size() - 1; }
+    const SDL_Point* line(size_t i) const { return points.data() + starts[i]; }
+    size_t length(size_t i) const { return starts[i + 1] - starts[i]; }
+};
+
+// 单个方程在细网格节点上的采样缓存, 节点 (i, j) 的数学坐标为 (x0 + j * dx, y0 + i * dy)
+struct SampleCache
+{
+    std::shared_ptr<const eval::program<double>> program;
+    double x0 = 0.0;
+    double y0 = 0.0;
+    double dx = 0.0;
+    double dy = 0.0;
+    size_t rows = 0;
+    size_t cols = 0;
+    std::vector<double> values;
+    std::vector<eval::dual<double>> gradients;
+    // 本次采样开始前由旧缓存重映射得到, 各区块只读
+    std::vector<double> seedValues;
+    std::vector<eval::dual<double>> seedGradients;
+};
+
+// 分帧补全中的完整精度结果, 全部区块完成后才替换显示的结果
+struct PlotRefinement
+{
+    std::vector<PlotTile> tiles;
+    size_t next = 0;
+    bool active = false;
+    std::shared_ptr<const eval::program<double>> program;
+    RelationalOperator type = RelationalOperator::INVALID;
+    MathRange range;
+};
+
+struct PlotResult
+{
+    std::vector<PlotTile> tiles;
+    // 预览结果和显式方程才有折线, 完整精度的隐式曲线不拼接
+    Contours contours;
+    bool failed = false;
+    // 计算失败的原因
+    std::string error;
+    bool preview = false;
+    bool shaded = false;
+    // 每次重新绘制结果后递增, 供渲染端判断缓存的图层是否过期
+    size_t revision = 0;
+    // 最近一次 plot 调用中花在这个方程上的时间 (毫秒, 多个线程的耗时累加)
+    double sampleTime = 0.0;
+    double contourTime = 0.0;
+    // 每个采样点的平均耗时 (纳秒), 对最近几次计算做指数滑动平均, 方程改变后重新统计
+    double cost = 0.0;
+    std::shared_ptr<const eval::program<double>> costProgram;
+    RelationalOperator type = RelationalOperator::INVALID;
+    std::shared_ptr<const eval::program<double>> program;
+    MathRange range;
+    SampleCache cache;
+    PlotRefinement refinement;
+};
+
+// 一次 plot 调用如何在方程之间分配时间
+struct PlotSchedule
+{
+    // 正在编辑的方程, 只画粗网格预览
+    size_t preview = eval::size_max;
+    // 选中的方程, 最先补全, 也不会因为耗时过高被推迟
+    size_t focus = eval::size_max;
+    // 补全区块的时间预算 (毫秒)
+    double budget = std::numeric_limits<double>::infinity();
+    // 补不完的方程保留上一次的结果 (range 与 view 不同), 由调用方映射到新视图, 没有旧结果的仍画粗网格
+    bool keepStale = false;
+};
+
+// 把各区块的线段按共用的边交点首尾相连成折线, 再以 tolerance 像素为容差化简
+void stitchContours(const std::vector<PlotTile>& tiles, double tolerance, Contours& out);
+
+class EquationPlotter
+{
+private:
+    struct Grid
+    {
+        int width;
+        int height;
+        // 节点 0 所在的像素, 取值在 (-step, 0] 内; 平移时随内容移动以保持节点的数学坐标不变
+        int originX = 0;
+        int originY = 0;
+        size_t lstep;
+        size_t ffts;
+        size_t step;
+        size_t coarseRows;
+        size_t coarseCols;
+        size_t tilesX;
+        size_t tilesY;
+        size_t tileCells;
+        std::vector<double> xColumn;
+
+        Grid(int width, int height, size_t lstep, size_t ffts, size_t tileCells);
+        void place(int x, int y);
+        // 第 fine 个细网格节点所在的屏幕像素
+        int screenX(size_t fine) const;
+        int screenY(size_t fine) const;
+    };
+
+    struct Worker
+    {
+        const Grid* grid = nullptr;
+        eval::context<double> context;
+        eval::interval_context<double> bounds;
+        eval::dual_context<double> duals;
+        std::vector<double> coarse;
+        std::vector<double> fine;
+        std::vector<eval::dual<double>> gradient;
+        std::vector<char> crossing;
+        size_t tileY = 0;
+        size_t tileX = 0;
+    };
+
+    // 一批并行计算的区块: 方程 equation 的第 [begin, begin + count) 个区块
+    struct Job
+    {
+        size_t equation;
+        const Grid* grid;
+        std::vector<PlotTile>* tiles;
+        SampleCache* cache;
+        size_t begin;
+        size_t count;
+        size_t first;
+        bool failed;
+        std::string error = {};
+    };
+
+    ThreadPool pool;
+    std::vector<Worker> workers;
+
+    static constexpr size_t tileCells = 16;
+    // 网格缓冲按 SIZE_CLASS 像素分档预留
+    static constexpr int SIZE_CLASS = 256;
+    Grid fullGrid;
+    Grid previewGrid;
+    // 请求的采样密度, 下一次 plot 时生效
+    size_t lstep;
+    size_t ffts;
+    int classWidth = 0;
+    int classHeight = 0;
+    // 当前尺寸档位下完整精度网格最多的细节点数
+    size_t nodeCapacity = 0;
+    const double* xVar = nullptr;
+    const double* yVar = nullptr;
+
+    MathRange range;
+    // 显式方程着色时每个像素的覆盖率分级, 用完后清零
+    std::vector<Uint8> coverage;
+
+    void layoutGrids(int width, int height);
+    void placeGrid(const MathRange& view);
+    void seedCache(const Equation& eq, SampleCache& cache) const;
+    void loadCache(const SampleCache& cache, Worker& worker) const;
+    void storeCache(SampleCache& cache, Worker& worker) const;
+    double& coarseAt(Worker& worker, size_t cy, size_t cx) const;
+    void sampleNodes(const Equation& eq, Worker& worker, size_t y0, size_t y1, size_t x0, size_t x1);
+    void cullBlock(const Equation& eq, PlotTile& tile, Worker& worker, size_t y0, size_t y1, size_t x0, size_t x1, bool fill);
+    void pushFill(PlotTile& tile, const Grid& grid, int x, int y, int w, int h) const;
+    void fillBlock(const Equation& eq, PlotTile& tile, Worker& worker, size_t y0, size_t y1, size_t x0, size_t x1);
+    void extractBlock(const Equation& eq, PlotTile& tile, Worker& worker, size_t y0, size_t y1, size_t x0, size_t x1, bool fill, bool contour);
+    const eval::dual<double>& gradientAt(const Equation& eq, Worker& worker, size_t ly, size_t lx);
+    bool cellCorners(const Equation& eq, Worker& worker, size_t ly, size_t lx, double scaleX, double scaleY, eval::dual<double> (&corner)[4]);
+    void shadeTile(const Equation& eq, PlotTile& tile, Worker& worker);
+    void plotTile(const Equation& eq, const Grid& grid, PlotTile& tile, size_t index, Worker& worker, SampleCache* cache);
+    void runJobs(const std::vector<Equation>& equations, std::vector<Job>& jobs);
+    void plotExplicit(const Equation& eq, PlotResult& result);
+
+public:
+    EquationPlotter(int width, int height, size_t lstep = 5u, size_t ffts = 2u);
+    void bind(const double* x, const double* y);
+    // 细网格节点间距 lstep 像素, 每 ffts 个细节点取一个粗节点; 改变后所有方程重新采样
+    void setDensity(size_t lstep, size_t ffts);
+    // 网格尺寸跟随 view 的像素尺寸. 只重新采样结果已过期的方程; 正在编辑的方程用粗网格快速预览, 其余方程在预算内按优先级逐块补全到完整精度,
+    // 本次补不完的先显示粗网格结果, 下一次从停下的位置继续. 返回 false 表示还有未补全的方程
+    bool plot(const std::vector<Equation>& equations, const MathRange& view, std::vector<PlotResult>& results, const PlotSchedule& schedule = {});
+};
@@ -0,0 +1,173 @@
+#include "GlyphAtlas.hpp"
+#include <algorithm>
+
+bool GlyphAtlas::init(SDL_Renderer* renderer, TTF_Font* font)
+{
+    this->renderer = renderer;
+    this->font = font;
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, ATLAS_SIZE, ATLAS_SIZE);
+    if (!texture)
+        return false;
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    const std::vector<Uint32> blank(ATLAS_SIZE * ATLAS_SIZE, 0);
+    SDL_UpdateTexture(texture, nullptr, blank.data(), ATLAS_SIZE * sizeof(Uint32));
+    lineHeight = TTF_FontHeight(font);
+
+    // 常用的 ASCII 字符预先放入图集
+    for (Uint32 c = 32; c < 127; ++c)
+        find(c);
+    return true;
+}
+
+void GlyphAtlas::destroy()
+{
+    SDL_DestroyTexture(texture);
+    texture = nullptr;
+    glyphs.clear();
+    vertices.clear();
+    indices.clear();
+}
+
+Uint32 GlyphAtlas::decode(std::string_view text, size_t& pos)
+{
+    const unsigned char lead = static_cast<unsigned char>(text[pos++]);
+    if (lead < 0x80)
+        return lead;
+    int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+    if (!extra)
+        return '?';
+    Uint32 c = lead & (0x3F >> extra);
+    for (; extra > 0; --extra)
+    {
+        if (pos >= text.size() || (text[pos] & 0xC0) != 0x80)
+            return '?';
+        c = (c << 6) | (text[pos++] & 0x3F);
+    }
+    return c;
+}
+
+const GlyphAtlas::Glyph* GlyphAtlas::find(Uint32 codepoint)
+{
+    auto it = glyphs.find(codepoint);
+    if (it != glyphs.end())
+        return &it->second;
+    // TTF 的字形接口只接受基本多文种平面内的字符
+    if (codepoint > 0xFFFF)
+        return find('?');
+
+    int minx, maxx, miny, maxy, advance;
+    if (TTF_GlyphMetrics(font, static_cast<Uint16>(codepoint), &minx, &maxx, &miny, &maxy, &advance) != 0)
+        return nullptr;
+
+    // 单个字符按整串文字的方式渲染, 位图高度为行高, 基线位置与整串渲染一致
+    char utf8[4] = {};
+    if (codepoint < 0x80)
+        utf8[0] = static_cast<char>(codepoint);
+    else if (codepoint < 0x800)
+    {
+        utf8[0] = static_cast<char>(0xC0 | (codepoint >> 6));
+        utf8[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        utf8[0] = static_cast<char>(0xE0 | (codepoint >> 12));
+        utf8[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        utf8[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+
+    Glyph glyph{{0, 0, 0, 0}, std::min(0, minx), advance};
+    SDL_Surface* surface = TTF_RenderUTF8_Blended(font, utf8, {255, 255, 255, 255});
+    if (surface)
+    {
+        // 按行装箱, 字形之间留一像素空隙避免缩放采样时串色
+        if (shelfX + surface->w > ATLAS_SIZE)
+        {
+            shelfX = 0;
+            shelfY += shelfHeight + 1;
+            shelfHeight = 0;
+        }
+        if (shelfY + surface->h > ATLAS_SIZE)
+        {
+            // 图集已满: 先画掉排队中引用旧字形的文字, 再从头重建
+            flush();
+            glyphs.clear();
+            shelfX = 0;
+            shelfY = 0;
+            shelfHeight = 0;
+        }
+        glyph.source = {shelfX, shelfY, surface->w, surface->h};
+        SDL_UpdateTexture(texture, &glyph.source, surface->pixels, surface->pitch);
+        shelfX += surface->w + 1;
+        shelfHeight = std::max(shelfHeight, surface->h);
+        SDL_FreeSurface(surface);
+    }
+    return &glyphs.emplace(codepoint, glyph).first->second;
+}
+
+int GlyphAtlas::measure(std::string_view text)
+{
+    int width = 0;
+    if (!texture)
+        return width;
+    for (size_t pos = 0; pos < text.size();)
+        if (const Glyph* glyph = find(decode(text, pos)))
+            width += glyph->advance;
+    return width;
+}
+
+void GlyphAtlas::add(std::string_view text, float x, float y, SDL_Color color, float scale, float left, float right)
+{
+    if (!texture)
+        return;
+    const float texel = 1.0f / ATLAS_SIZE;
+    float pen = x;
+    for (size_t pos = 0; pos < text.size();)
+    {
+        const Glyph* glyph = find(decode(text, pos));
+        if (!glyph)
+            continue;
+        const SDL_Rect& source = glyph->source;
+        float x0 = pen + glyph->offset * scale;
+        float x1 = x0 + source.w * scale;
+        pen += glyph->advance * scale;
+        if (x0 >= right)
+            break;
+        if (source.w == 0 || x1 <= left)
+            continue;
+
+        float u0 = static_cast<float>(source.x);
+        float u1 = static_cast<float>(source.x + source.w);
+        if (x0 < left)
+        {
+            u0 += (left - x0) / scale;
+            x0 = left;
+        }
+        if (x1 > right)
+        {
+            u1 -= (x1 - right) / scale;
+            x1 = right;
+        }
+        const float v0 = static_cast<float>(source.y) * texel;
+        const float v1 = static_cast<float>(source.y + source.h) * texel;
+        const float y1 = y + source.h * scale;
+        u0 *= texel;
+        u1 *= texel;
+
+        const int base = static_cast<int>(vertices.size());
+        vertices.push_back({{x0, y}, color, {u0, v0}});
+        vertices.push_back({{x1, y}, color, {u1, v0}});
+        vertices.push_back({{x1, y1}, color, {u1, v1}});
+        vertices.push_back({{x0, y1}, color, {u0, v1}});
+        for (int i : {0, 1, 2, 0, 2, 3})
+            indices.push_back(base + i);
+    }
+}
+
+void GlyphAtlas::flush()
+{
+    if (indices.empty())
+        return;
+    SDL_RenderGeometry(renderer, texture, vertices.data(), static_cast<int>(vertices.size()), indices.data(), static_cast<int>(indices.size()));
+    vertices.clear();
+    indices.clear();
+}
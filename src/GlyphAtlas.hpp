@@ -0,0 +1,49 @@
+#pragma once
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 字形图集: 每个字形只光栅化、上传一次, 文字以图集上的四边形攒成一批后一次绘制
+class GlyphAtlas
+{
+private:
+    struct Glyph
+    {
+        SDL_Rect source;
+        // 字形位图左边相对笔位置的偏移, 以及笔位置的前进量
+        int offset;
+        int advance;
+    };
+
+    static constexpr int ATLAS_SIZE = 1024;
+
+    SDL_Renderer* renderer = nullptr;
+    TTF_Font* font = nullptr;
+    SDL_Texture* texture = nullptr;
+    int lineHeight = 0;
+    int shelfX = 0;
+    int shelfY = 0;
+    int shelfHeight = 0;
+    std::unordered_map<Uint32, Glyph> glyphs;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+
+    const Glyph* find(Uint32 codepoint);
+    static Uint32 decode(std::string_view text, size_t& pos);
+
+public:
+    GlyphAtlas() = default;
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+    // 未初始化的图集不绘制任何文字
+    bool init(SDL_Renderer* renderer, TTF_Font* font);
+    void destroy();
+    int height() const { return lineHeight; }
+    int measure(std::string_view text);
+    // 把文字加入当前批次, 只保留落在 [left, right) 内的部分; 批次在 flush 时才真正绘制
+    void add(std::string_view text, float x, float y, SDL_Color color, float scale = 1.0f, float left = -1e9f, float right = 1e9f);
+    void flush();
+};
@@ -1,17 +1,35 @@
 #include "ItemList.hpp"
+#include <algorithm>
 
-void ItemList::updateButtonPositions(int panelX)
+namespace
+{
+    const eval::var<double>* variable(const std::string& name)
+    {
+        const auto node = Equation::evaluator.vars->search(name);
+        return node ? node->data : nullptr;
+    }
+
+    // side 只有一个变量 var, 且另一侧 other 不含 var 时, 方程可以直接解出 var
+    bool solvedFor(const eval::epre<double>& side, const eval::epre<double>& other, const eval::var<double>* var)
+    {
+        return var && side.index == "v" && side.vars[0] == var && std::find(other.vars.begin(), other.vars.end(), var) == other.vars.end();
+    }
+}
+
+void ItemList::updateButtonPositions(int panelX, int height)
 {
     using namespace Constants;
+    windowWidth = panelX + PANEL_WIDTH;
+    windowHeight = height;
     addButton = {
         panelX + MARGIN,
-        WINDOW_HEIGHT - BUTTON_HEIGHT * 2 - MARGIN * 2,
+        windowHeight - BUTTON_HEIGHT * 2 - MARGIN * 2,
         PANEL_WIDTH - MARGIN * 2,
         BUTTON_HEIGHT
     };
     delButton = {
         panelX + MARGIN,
-        WINDOW_HEIGHT - BUTTON_HEIGHT - MARGIN,
+        windowHeight - BUTTON_HEIGHT - MARGIN,
         PANEL_WIDTH - MARGIN * 2,
         BUTTON_HEIGHT
     };
@@ -21,6 +39,7 @@ int ItemList::add(const std::string& item)
 {
     Equation eq;
     eq.expression = item;
+    compile(eq);
     if (selected == -1)
     {
         equations.push_back(std::move(eq));
@@ -40,73 +59,126 @@ void ItemList::removeSelected()
     }
 }
 
-void ItemList::endEdit()
+bool ItemList::compile(Equation& eq)
 {
-    if (selected == -1)
-        return;
-
-    Equation& eq = equations[selected];
-    eq.value.clear();
-    eq.type = RelationalOperator::INVALID;
-
-    selected = -1;
-    cursorPos = 0;
-
     if (eq.expression.empty())
-        return;
+        return false;
 
+    // 找到第一个关系运算符, pos 停在它的第一个字符上; 运算符不能是最后一个字符
+    RelationalOperator type = RelationalOperator::INVALID;
     size_t pos = 0;
-    while (eq.type == RelationalOperator::INVALID)
+    for (; pos + 1 < eq.expression.size(); ++pos)
     {
-        if (pos == eq.expression.size()-1)
-            break;
-
+        const bool equals = eq.expression[pos + 1] == '=';
         switch (eq.expression[pos])
         {
-            case '=': 
-                eq.type = RelationalOperator::EQUAL;
+            case '=':
+                type = RelationalOperator::EQUAL;
                 break;
             case '<':
-                if (eq.expression[pos+1] == '=')
-                    eq.type = RelationalOperator::LESS_THAN_OR_EQUAL;
-                else
-                    eq.type = RelationalOperator::LESS_THAN;
+                type = equals ? RelationalOperator::LESS_THAN_OR_EQUAL : RelationalOperator::LESS_THAN;
                 break;
             case '>':
-                if (eq.expression[pos+1] == '=')
-                    eq.type = RelationalOperator::GREATER_THAN_OR_EQUAL;
-                else
-                    eq.type = RelationalOperator::GREATER_THAN;
+                type = equals ? RelationalOperator::GREATER_THAN_OR_EQUAL : RelationalOperator::GREATER_THAN;
                 break;
             case '!':
-                if (eq.expression[pos+1] == '=')
-                    eq.type = RelationalOperator::NOT_EQUAL;
+                if (equals)
+                    type = RelationalOperator::NOT_EQUAL;
                 break;
             default:
-                pos++;
                 break;
         }
+        if (type != RelationalOperator::INVALID)
+            break;
     }
 
-    if (eq.type == RelationalOperator::INVALID)
-        return;
+    if (type == RelationalOperator::INVALID)
+        return false;
 
     try 
     {
-        Equation::evaluator.parse(eq.value, eq.expression.substr(0,pos));
+        eval::epre<double> left, right;
+        const std::string_view expression = eq.expression;
+        if (Equation::evaluator.parse(left, expression.substr(0,pos)) != eval::size_max)
+            return false;
         pos++;
-        if (eq.type == RelationalOperator::NOT_EQUAL || eq.type == RelationalOperator::GREATER_THAN_OR_EQUAL || eq.type == RelationalOperator::LESS_THAN_OR_EQUAL)
+        if (type == RelationalOperator::NOT_EQUAL || type == RelationalOperator::GREATER_THAN_OR_EQUAL || type == RelationalOperator::LESS_THAN_OR_EQUAL)
             pos++;
             
-        Equation::evaluator.parse(eq.value,eq.expression.substr(pos));
-        
-        eq.value.index.push_back('f');
-        eq.value.funcs.push_back(Equation::evaluator.infix_ops->search("-")->data);
+        if (Equation::evaluator.parse(right, expression.substr(pos)) != eval::size_max)
+            return false;
+
+        // y = f(x) 和 x = g(y) 形式的方程改用一维采样, 只需编译另一侧
+        ExplicitForm form = ExplicitForm::NONE;
+        const eval::epre<double>* function = nullptr;
+        if (type == RelationalOperator::EQUAL)
+        {
+            const eval::var<double>* x = variable("x");
+            const eval::var<double>* y = variable("y");
+            for (const auto& [side, other] : {std::make_pair(&left, &right), std::make_pair(&right, &left)})
+            {
+                if (solvedFor(*side, *other, y))
+                    form = ExplicitForm::Y_OF_X;
+                else if (solvedFor(*side, *other, x))
+                    form = ExplicitForm::X_OF_Y;
+                else
+                    continue;
+                function = other;
+                break;
+            }
+        }
+        std::shared_ptr<const eval::program<double>> compiled;
+        if (function)
+        {
+            eval::program<double> program = Equation::evaluator.compile(*function);
+            eval::optimize(program);
+            compiled = std::make_shared<const eval::program<double>>(std::move(program));
+        }
+
+        eval::epre<double> value = left;
+        value.funcs.insert(value.funcs.end(), right.funcs.begin(), right.funcs.end());
+        value.vars.insert(value.vars.end(), right.vars.begin(), right.vars.end());
+        value.consts.insert(value.consts.end(), right.consts.begin(), right.consts.end());
+        value.index += right.index;
+        value.index.push_back('f');
+        value.funcs.push_back(Equation::evaluator.infix_ops->search("-")->data);
+        eval::program<double> program = Equation::evaluator.compile(value);
+        eval::optimize(program);
+
+        eq.type = type;
+        eq.value = std::move(value);
+        eq.program = std::make_shared<const eval::program<double>>(std::move(program));
+        eq.form = form;
+        eq.function = std::move(compiled);
+        // 耗时和错误属于旧程序, 解析失败时保留, 仍对应屏幕上的旧曲线
+        eq.cost = 0.0;
+        eq.error.clear();
+        return true;
     }
     catch (...)
+    {
+        return false;
+    }
+}
+
+void ItemList::endEdit()
+{
+    if (selected == -1)
+        return;
+
+    Equation& eq = equations[selected];
+    selected = -1;
+    cursorPos = 0;
+
+    if (!compile(eq))
     {
         eq.value.clear();
+        eq.program.reset();
+        eq.form = ExplicitForm::NONE;
+        eq.function.reset();
         eq.type = RelationalOperator::INVALID;
+        eq.cost = 0.0;
+        eq.error.clear();
     }
 }
 
@@ -130,6 +202,9 @@ void ItemList::handleInput(const SDL_Event& e, SDL_Renderer* renderer)
     {
         eq.expression.insert(cursorPos, e.text.text);
         cursorPos += strlen(e.text.text);
+        // 边输入边解析, 当前文本无效时保留上一次有效的结果
+        compile(eq);
+        lastEdit = SDL_GetTicks();
     }
     else if (e.type == SDL_KEYDOWN)
     {
@@ -166,6 +241,8 @@ void ItemList::handleInput(const SDL_Event& e, SDL_Renderer* renderer)
                     size_t size = eq.expression[cursorPos - 1u] < 0 ? 3u : 1u;
                     eq.expression.erase(cursorPos - size,size);
                     cursorPos-=size;
+                    compile(eq);
+                    lastEdit = SDL_GetTicks();
                 }
                 break;
             case SDLK_DELETE:
@@ -190,12 +267,18 @@ void ItemList::handleInput(const SDL_Event& e, SDL_Renderer* renderer)
 }
 void ItemList::selectColor(SDL_Renderer*renderer)
 {
+    // 按窗口坐标绘制, 与鼠标坐标一致; HiDPI 下放大到渲染器的实际像素
+    int outputWidth = windowWidth;
+    SDL_GetRendererOutputSize(renderer, &outputWidth, nullptr);
+    const float scale = static_cast<float>(outputWidth) / windowWidth;
+    SDL_RenderSetScale(renderer, scale, scale);
+
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 128);
-    SDL_Rect mask = { 0, 0, Constants::WINDOW_WIDTH, Constants::WINDOW_HEIGHT };
+    SDL_Rect mask = { 0, 0, windowWidth, windowHeight };
     SDL_RenderFillRect(renderer, &mask);
 
-    SDL_Rect colorRect{(Constants::WINDOW_WIDTH>>1)-153,(Constants::WINDOW_HEIGHT >> 1) - 123,256,256};
+    SDL_Rect colorRect{(windowWidth>>1)-153,(windowHeight >> 1) - 123,256,256};
     SDL_Rect rRect{ colorRect.x+270,colorRect.y,50,256 };
     SDL_Rect MainRect{colorRect.x-10,colorRect.y-40,rRect.x-colorRect.x+rRect.w+20,306 };
     SDL_Rect LastRect{ MainRect.x + 10,MainRect.y + 10,((MainRect.w - 20)>>1)-5,20 };
@@ -234,7 +317,7 @@ void ItemList::selectColor(SDL_Renderer*renderer)
                 if (e.key.keysym.sym == SDLK_ESCAPE|| e.key.keysym.sym == SDLK_RETURN)
                     isRunning = false;
                 if (e.key.keysym.sym == SDLK_RETURN)
-                    equations[selected].color = { r,g,b };
+                    equations[selected].color = { r,g,b,255 };
                 break;
             case SDL_MOUSEBUTTONDOWN:
                 buttondown = true;
@@ -285,7 +368,7 @@ void ItemList::selectColor(SDL_Renderer*renderer)
         if (frameTime < targetDelay)
             SDL_Delay(targetDelay - frameTime);
     }
-
+    SDL_RenderSetScale(renderer, 1.0f, 1.0f);
 }
 
 void ItemList::select(int index)
@@ -300,9 +383,20 @@ void ItemList::select(int index)
     }
 }
 
-void ItemList::handleScroll(int delta)
+size_t ItemList::getPreview() const
+{
+    if (selected == -1 || SDL_GetTicks() - lastEdit >= Constants::PREVIEW_DELAY)
+        return eval::size_max;
+    return static_cast<size_t>(selected);
+}
+
+int ItemList::getVisibleItems() const
 {
     using namespace Constants;
-    int visibleItems = (WINDOW_HEIGHT - (BUTTON_HEIGHT << 1 + MARGIN * 3)) / TOTAL_HEIGHT;
-    scrollOffset = std::max(0, std::min(scrollOffset - delta, static_cast<int>(equations.size()) - visibleItems));
+    return (windowHeight - (BUTTON_HEIGHT * 2 + MARGIN * 3)) / TOTAL_HEIGHT;
+}
+
+void ItemList::handleScroll(int delta)
+{
+    scrollOffset = std::max(0, std::min(scrollOffset - delta, static_cast<int>(equations.size()) - getVisibleItems()));
 }
\ No newline at end of file
@@ -13,10 +13,16 @@ private:
     int scrollOffset = 0;
     SDL_Rect addButton{0, 0, 0, 0};
     SDL_Rect delButton{0, 0, 0, 0};
+    // 窗口的逻辑尺寸 (窗口坐标)
+    int windowWidth = Constants::WINDOW_WIDTH;
+    int windowHeight = Constants::WINDOW_HEIGHT;
+    Uint32 lastEdit = 0;
+
+    bool compile(Equation& eq);
 
 public:
     ItemList() = default;
-    void updateButtonPositions(int panelX);
+    void updateButtonPositions(int panelX, int height);
     int add(const std::string& item);
     void removeSelected();
     void endEdit();
@@ -32,4 +38,8 @@ public:
     const SDL_Rect& getDelButton() const { return delButton; }
     int getCursorPos() const { return cursorPos; }
     int getScrollOffset() const { return scrollOffset; }
+    // 按钮下方能完整显示的方程条目数, 滚动范围和面板绘制都用它
+    int getVisibleItems() const;
+    size_t getPreview() const;
+    Uint32 getLastEdit() const { return lastEdit; }
 };
\ No newline at end of file
@@ -15,6 +15,12 @@ double MathRange::ySpan() const
     return yMax - yMin;
 }
 
+bool MathRange::operator==(const MathRange& other) const
+{
+    return xMin == other.xMin && xMax == other.xMax && yMin == other.yMin && yMax == other.yMax
+        && width == other.width && height == other.height;
+}
+
 std::string formatNumber(double value, int precision)
 {
     if (std::isnan(value) || std::isinf(value))
@@ -48,15 +54,15 @@ std::string formatNumber(double value, int precision)
 Point2D mathToScreen(const Point2D& mathPoint, const MathRange& range)
 {
     return {
-        (mathPoint.x - range.xMin) / range.xSpan() * 1200.0,
-        (range.yMax - mathPoint.y) / range.ySpan() * Constants::WINDOW_HEIGHT
+        (mathPoint.x - range.xMin) / range.xSpan() * range.width,
+        (range.yMax - mathPoint.y) / range.ySpan() * range.height
     };
 }
 
 Point2D screenToMath(int sx, int sy, const MathRange& range)
 {
     return {
-        range.xMin + static_cast<double>(sx) * range.xSpan() / 1200.0,
-        range.yMax - static_cast<double>(sy) * range.ySpan() / Constants::WINDOW_HEIGHT
+        range.xMin + static_cast<double>(sx) * range.xSpan() / range.width,
+        range.yMax - static_cast<double>(sy) * range.ySpan() / range.height
     };
 }
\ No newline at end of file
@@ -15,8 +15,12 @@ struct MathRange
 {
     double xMin = -15.0, xMax = 15.0;
     double yMin = -10.0, yMax = 10.0;
+    // 绘图区的像素尺寸 (渲染器的实际像素, HiDPI 下大于窗口坐标)
+    int width = Constants::WINDOW_WIDTH - Constants::PANEL_WIDTH;
+    int height = Constants::WINDOW_HEIGHT;
     double xSpan() const;
     double ySpan() const;
+    bool operator==(const MathRange& other) const;
 };
 
 std::string formatNumber(double value, int precision);
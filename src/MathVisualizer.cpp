@@ -1,43 +1,210 @@
 #include "MathVisualizer.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 
 bool MathVisualizer::init()
 {
     if (SDL_Init(SDL_INIT_VIDEO) != 0)
         return false;
     window = SDL_CreateWindow("Math Visualizer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                              Constants::WINDOW_WIDTH, Constants::WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
+                              Constants::WINDOW_WIDTH, Constants::WINDOW_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
     if (!window)
         return false;
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    SDL_SetWindowMinimumSize(window, Constants::PANEL_WIDTH + Constants::MIN_PLOT_SIZE, Constants::MIN_PLOT_SIZE);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
     if (!renderer)
         return false;
+    if (!setup(Constants::FONT_PATH, true))
+        return false;
+    // 方程在后台线程上计算, 算出新结果时用这个事件唤醒主循环
+    const Uint32 plotEvent = SDL_RegisterEvents(1);
+    if (plotEvent != static_cast<Uint32>(-1))
+        plotter.start(plotEvent);
+    return true;
+}
+
+bool MathVisualizer::initHeadless(const char* fontPath)
+{
+    if (SDL_Init(0) != 0)
+        return false;
+    canvas = SDL_CreateRGBSurfaceWithFormat(0, currentRange.width, currentRange.height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!canvas)
+        return false;
+    renderer = SDL_CreateSoftwareRenderer(canvas);
+    if (!renderer)
+        return false;
+    // 不启动后台线程, 每次都在调用线程上一次画完
+    return setup(fontPath, false);
+}
+
+bool MathVisualizer::setup(const char* fontPath, bool requireFont)
+{
+    if (!resize())
+        return false;
+
+    Equation::evaluator.vars->insert("x",{eval::vartype::FREEVAR, 0.0});
+    Equation::evaluator.vars->insert("y",{eval::vartype::FREEVAR, 0.0});
+
+    plotter.bind(&Equation::evaluator.vars->search("x")->data->value,
+                 &Equation::evaluator.vars->search("y")->data->value);
+
     if (TTF_Init() == -1)
         return false;
-    font = TTF_OpenFont("C:/Windows/Fonts/msyh.ttc", 18);
+    font = TTF_OpenFont(fontPath, 18);
     if (!font)
+        return !requireFont;
+    return atlas.init(renderer, font);
+}
+
+bool MathVisualizer::resize()
+{
+    using namespace Constants;
+    int outputWidth = 0;
+    int outputHeight = 0;
+    if (SDL_GetRendererOutputSize(renderer, &outputWidth, &outputHeight) != 0)
+        return false;
+    // 无窗口模式没有面板, 整个画布都是绘图区
+    int width = outputWidth;
+    int height = outputHeight;
+    if (window)
+        SDL_GetWindowSize(window, &width, &height);
+    const float previousScale = pixelScale;
+    pixelScale = static_cast<float>(outputWidth) / std::max(1, width);
+    panelX = std::max(1, window ? width - PANEL_WIDTH : width);
+    windowHeight = height;
+    itemList.updateButtonPositions(panelX, windowHeight);
+
+    // 每个窗口坐标单位对应的数学长度不变, 以原视图中心为中心扩展或收缩
+    const int plotWidth = std::max(1, static_cast<int>(std::lround(panelX * pixelScale)));
+    const int plotHeight = std::max(1, outputHeight);
+    const double halfX = currentRange.xSpan() * previousScale / currentRange.width / pixelScale * plotWidth / 2;
+    const double halfY = currentRange.ySpan() * previousScale / currentRange.height / pixelScale * plotHeight / 2;
+    const double centerX = currentRange.xMin + currentRange.xSpan() / 2;
+    const double centerY = currentRange.yMin + currentRange.ySpan() / 2;
+    currentRange = {centerX - halfX, centerX + halfX, centerY - halfY, centerY + halfY, plotWidth, plotHeight};
+
+    // 绘图区的纹理按新的像素尺寸重建, 方程图层在下次绘制时创建
+    SDL_DestroyTexture(regionTexture);
+    SDL_DestroyTexture(gridLayer);
+    for (Layer& layer : layers)
+    {
+        SDL_DestroyTexture(layer.texture);
+        layer.texture = nullptr;
+        layer.revision = 0;
+    }
+    gridStale = true;
+    regionsStale = true;
+    regionsShown = false;
+    regionTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, plotWidth, plotHeight);
+    if (!regionTexture)
+        return false;
+    SDL_SetTextureBlendMode(regionTexture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(regionTexture, SDL_ScaleModeLinear);
+    gridLayer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, plotWidth, plotHeight);
+    if (!gridLayer)
         return false;
-    itemList.updateButtonPositions(panelX);
+    updateDensity();
+    return true;
+}
 
-    Equation::evaluator.vars->insert("x",{});
-    Equation::evaluator.vars->insert("y",{});
+void MathVisualizer::updateDensity()
+{
+    // 节点间距按窗口坐标计, HiDPI 下每个逻辑像素的采样数不变; 画质档位只改变细网格间距, 粗网格间距保持不变
+    const double spacing = baseLstep * pixelScale * Constants::QUALITY_SCALES[quality];
+    const size_t lstep = std::max<size_t>(1, static_cast<size_t>(std::lround(spacing)));
+    const double coarse = static_cast<double>(baseLstep * baseFfts) * pixelScale;
+    const size_t ffts = std::max<size_t>(1, static_cast<size_t>(std::lround(coarse / lstep)));
+    plotter.setDensity(lstep, ffts);
+}
 
-    xNode = Equation::evaluator.vars->search("x");
-    yNode = Equation::evaluator.vars->search("y");
+void MathVisualizer::setRange(const MathRange& range)
+{
+    const int width = currentRange.width;
+    const int height = currentRange.height;
+    currentRange = range;
+    currentRange.width = width;
+    currentRange.height = height;
+}
 
-    return true;
+bool MathVisualizer::addEquation(const std::string& expression, SDL_Color color)
+{
+    Equation& eq = itemList.getEquations()[itemList.add(expression)];
+    eq.color = color;
+    return eq.type != RelationalOperator::INVALID;
+}
+
+bool MathVisualizer::renderToFile(const std::string& path)
+{
+    using namespace Constants;
+    renderFrame();
+
+    const SDL_Rect area{0, 0, currentRange.width, currentRange.height};
+    const int pitch = area.w * 3;
+    std::vector<Uint8> pixels(static_cast<size_t>(pitch) * area.h);
+    if (SDL_RenderReadPixels(renderer, &area, SDL_PIXELFORMAT_RGB24, pixels.data(), pitch) != 0)
+        return false;
+
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".bmp") == 0)
+    {
+        SDL_Surface* image = SDL_CreateRGBSurfaceWithFormatFrom(pixels.data(), area.w, area.h, 24, pitch, SDL_PIXELFORMAT_RGB24);
+        if (!image)
+            return false;
+        const bool saved = SDL_SaveBMP(image, path.c_str()) == 0;
+        SDL_FreeSurface(image);
+        return saved;
+    }
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << area.w << ' ' << area.h << "\n255\n";
+    out.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+    return static_cast<bool>(out);
 }
 
 void MathVisualizer::handleEvents()
 {
     SDL_Event e;
-    while (SDL_PollEvent(&e))
+    // 没有要处理的事件时阻塞, 只有定时任务到期才不带事件地醒来重绘
+    const int timeout = idleTimeout();
+    if (!(timeout < 0 ? SDL_WaitEvent(&e) : SDL_WaitEventTimeout(&e, timeout)))
+    {
+        redraw = true;
+        return;
+    }
+    Profiler::Scope scope(profiler, "events");
+    do
     {
+        // 不拖动时的鼠标移动不改变画面
+        if (e.type != SDL_MOUSEMOTION || isDragging)
+            redraw = true;
         itemList.handleInput(e,renderer);
         switch (e.type)
         {
             case SDL_QUIT:
                 isRunning = false;
                 break;
+            case SDL_KEYDOWN:
+                if (e.key.keysym.sym == SDLK_F3)
+                    hudShown = !hudShown;
+                else if (e.key.keysym.sym == SDLK_F4)
+                    SDL_Log(profiler.exportTrace(Constants::TRACE_PATH) ? "trace written to %s" : "failed to write %s", Constants::TRACE_PATH);
+                else if (e.key.keysym.sym == SDLK_F5)
+                {
+                    quality = (quality + 1) % Constants::QUALITY_LEVELS;
+                    updateDensity();
+                    SDL_Log("quality %d/%d", quality + 1, Constants::QUALITY_LEVELS);
+                }
+                break;
+            case SDL_WINDOWEVENT:
+                // 拖动窗口大小或移到像素密度不同的显示器上
+                if (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED && !resize())
+                    SDL_Log("failed to resize: %s", SDL_GetError());
+                break;
+            case SDL_RENDER_TARGETS_RESET:
+                // 渲染目标纹理的内容丢失, 所有图层都要重画
+                gridStale = true;
+                for (Layer& layer : layers)
+                    layer.revision = 0;
+                break;
             case SDL_MOUSEBUTTONDOWN:
                 if (e.button.x > panelX)
                     handlePanelClick(e.button);
@@ -57,8 +224,8 @@ void MathVisualizer::handleEvents()
                 if (isDragging)
                 {
                     Point2D current = {static_cast<double>(e.motion.x), static_cast<double>(e.motion.y)};
-                    Point2D delta = screenToMath(current.x, current.y, currentRange) - 
-                                    screenToMath(dragStart.x, dragStart.y, currentRange);
+                    Point2D delta = screenToMath(current.x * pixelScale, current.y * pixelScale, currentRange) - 
+                                    screenToMath(dragStart.x * pixelScale, dragStart.y * pixelScale, currentRange);
                     currentRange.xMin = dragStartRange.xMin - delta.x;
                     currentRange.xMax = dragStartRange.xMax - delta.x;
                     currentRange.yMin = dragStartRange.yMin - delta.y;
@@ -75,6 +242,7 @@ void MathVisualizer::handleEvents()
                     const double zoomCenterX = currentRange.xMin + currentRange.xSpan()/2;
                     const double zoomCenterY = currentRange.yMin + currentRange.ySpan()/2;
                     const double zoomFactor = (e.wheel.y > 0) ? 0.9 : 1.1;
+                    settleTime = SDL_GetTicks() + Constants::SETTLE_DELAY;
                     currentRange.xMin = zoomCenterX + (currentRange.xMin - zoomCenterX) * zoomFactor;
                     currentRange.xMax = zoomCenterX + (currentRange.xMax - zoomCenterX) * zoomFactor;
                     currentRange.yMin = zoomCenterY + (currentRange.yMin - zoomCenterY) * zoomFactor;
@@ -82,36 +250,21 @@ void MathVisualizer::handleEvents()
                 }
                 break;
         }
-    }
+    } while (SDL_PollEvent(&e));
 }
 
 void MathVisualizer::renderText(const std::string& text, int x, int y, int maxWidth)
 {
-    SDL_Surface* surface = TTF_RenderUTF8_Blended(font, text.c_str(), Constants::TEXT_COLOR);
-    if (!surface)
-        return;
-    if (surface->w > maxWidth)
-    {
-        float scale = static_cast<float>(maxWidth) / surface->w;
-        SDL_Rect dstRect = {x, y, static_cast<int>(surface->w * scale), static_cast<int>(surface->h * scale)};
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_RenderCopy(renderer, texture, nullptr, &dstRect);
-        SDL_DestroyTexture(texture);
-    }
-    else
-    {
-        SDL_Rect dstRect = {x, y, surface->w, surface->h};
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_RenderCopy(renderer, texture, nullptr, &dstRect);
-        SDL_DestroyTexture(texture);
-    }
-    SDL_FreeSurface(surface);
+    // 超出宽度时整体缩小
+    const int width = atlas.measure(text);
+    const float scale = width > maxWidth ? static_cast<float>(maxWidth) / width : 1.0f;
+    atlas.add(text, static_cast<float>(x), static_cast<float>(y), Constants::TEXT_COLOR, scale);
 }
 
 void MathVisualizer::renderPanel()
 {
     using namespace Constants;
-    SDL_Rect panelRect = { panelX, 0, PANEL_WIDTH, WINDOW_HEIGHT };
+    SDL_Rect panelRect = { panelX, 0, PANEL_WIDTH, windowHeight };
     SDL_SetRenderDrawColor(renderer, PANEL_COLOR.r, PANEL_COLOR.g, PANEL_COLOR.b, 255);
     SDL_RenderFillRect(renderer, &panelRect);
 
@@ -122,8 +275,9 @@ void MathVisualizer::renderPanel()
     SDL_RenderFillRect(renderer, &delBtn);
     renderText("+ Add", addBtn.x + 10, addBtn.y + 3, addBtn.w - 20);
     renderText("- Delete", delBtn.x + 10, delBtn.y + 3, delBtn.w - 20);
+    atlas.flush();
 
-    visibleItems = (WINDOW_HEIGHT - (BUTTON_HEIGHT * 2 + MARGIN * 3)) / TOTAL_HEIGHT;
+    visibleItems = itemList.getVisibleItems();
     const int startIdx = itemList.getScrollOffset();
     const int endIdx = std::min(startIdx + visibleItems, static_cast<int>(itemList.getEquations().size()));
 
@@ -136,6 +290,8 @@ void MathVisualizer::renderPanel()
     };
     SDL_RenderSetClipRect(renderer, &listClipRect);
 
+    // 文字攒到最后一次绘制, 光标画在文字之上
+    SDL_Rect cursor{0, 0, 0, 0};
     int yPos = MARGIN;
     for (int i = startIdx; i < endIdx; ++i)
     {
@@ -164,15 +320,11 @@ void MathVisualizer::renderPanel()
 
         if (itemList.isEditing() && isSelected)
         {
-            const std::string& text = eq.expression;
+            const std::string_view text = eq.expression;
             const int cursorPos = itemList.getCursorPos();
 
-            int fullTextWidth = 0;
-            TTF_SizeUTF8(font, text.c_str(), &fullTextWidth, nullptr);
-
-            std::string beforeCursor = text.substr(0, cursorPos);
-            int cursorPixelPos = 0;
-            TTF_SizeUTF8(font, beforeCursor.c_str(), &cursorPixelPos, nullptr);
+            const int fullTextWidth = atlas.measure(text);
+            const int cursorPixelPos = atlas.measure(text.substr(0, cursorPos));
 
             int renderOffset = 0;
             if (fullTextWidth > maxTextWidth)
@@ -183,64 +335,36 @@ void MathVisualizer::renderPanel()
                 renderOffset = std::min(renderOffset, fullTextWidth - maxTextWidth);
             }
 
-            SDL_Surface* surface = TTF_RenderUTF8_Blended(font, text.c_str(), TEXT_COLOR);
-            if (surface)
-            {
-                SDL_Rect srcRect
-                {
-                    renderOffset, 0,
-                    std::min(maxTextWidth, surface->w - renderOffset),
-                    surface->h
-                };
+            const float left = static_cast<float>(textRect.x);
+            atlas.add(text, left - renderOffset, static_cast<float>(textRect.y), TEXT_COLOR, 1.0f, left, left + maxTextWidth);
 
-                SDL_Rect dstRect
-                {
-                    textRect.x,
-                    textRect.y,
-                    srcRect.w,
-                    surface->h
-                };
-
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_RenderCopy(renderer, texture, &srcRect, &dstRect);
-                SDL_DestroyTexture(texture);
-                SDL_FreeSurface(surface);
-
-                if (SDL_GetTicks() - cursorBlink < 500)
-                {
-                    int visualCursorX = textRect.x + (cursorPixelPos - renderOffset);
-                    visualCursorX = std::max(textRect.x, std::min(visualCursorX, textRect.x + maxTextWidth - 2));
-
-                    SDL_SetRenderDrawColor(renderer, EDIT_COLOR.r, EDIT_COLOR.g, EDIT_COLOR.b, 255);
-                    SDL_RenderDrawLine(renderer,
-                        visualCursorX, textRect.y + 2,
-                        visualCursorX, textRect.y + textRect.h - 4
-                    );
-                }
+            if (SDL_GetTicks() - cursorBlink < 500)
+            {
+                int visualCursorX = textRect.x + (cursorPixelPos - renderOffset);
+                visualCursorX = std::max(textRect.x, std::min(visualCursorX, textRect.x + maxTextWidth - 2));
+                cursor = {visualCursorX, textRect.y + 2, 1, textRect.h - 5};
             }
         }
         else
         {
-            SDL_Surface* surface = TTF_RenderUTF8_Blended(font, eq.expression.c_str(), TEXT_COLOR);
-            if (surface)
+            // 打开 HUD 时在右侧显示每个采样点的平均耗时
+            const float left = static_cast<float>(textRect.x);
+            const int top = textRect.y + (textRect.h - atlas.height()) / 2;
+            int textWidth = maxTextWidth;
+            if (hudShown && eq.cost > 0.0)
             {
-                SDL_Rect srcRect = { 0, 0, std::min(surface->w, maxTextWidth), surface->h };
-
-                SDL_Rect dstRect = {
-                    textRect.x,
-                    textRect.y + (textRect.h - surface->h) / 2,
-                    srcRect.w,
-                    surface->h
-                };
-
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_RenderCopy(renderer, texture, &srcRect, &dstRect);
-                SDL_DestroyTexture(texture);
-                SDL_FreeSurface(surface);
+                char label[32];
+                std::snprintf(label, sizeof(label), "%.0f ns", eq.cost);
+                const int labelWidth = atlas.measure(label);
+                textWidth = std::max(0, maxTextWidth - labelWidth - 5);
+                atlas.add(label, static_cast<float>(textRect.x + maxTextWidth - labelWidth), static_cast<float>(top), AXIS_COLOR);
             }
+            atlas.add(eq.expression, left, static_cast<float>(top), TEXT_COLOR, 1.0f, left, left + textWidth);
         }
 
-        SDL_SetRenderDrawColor(renderer, GRID_COLOR.r, GRID_COLOR.g, GRID_COLOR.b, GRID_COLOR.a);
+        // 求值失败的方程用红色分隔线标出
+        const SDL_Color lineColor = eq.error.empty() ? GRID_COLOR : ERROR_COLOR;
+        SDL_SetRenderDrawColor(renderer, lineColor.r, lineColor.g, lineColor.b, lineColor.a);
         SDL_Rect lineRect
         {
             panelX + MARGIN,
@@ -252,6 +376,12 @@ void MathVisualizer::renderPanel()
 
         yPos += TOTAL_HEIGHT;
     }
+    atlas.flush();
+    if (cursor.w)
+    {
+        SDL_SetRenderDrawColor(renderer, EDIT_COLOR.r, EDIT_COLOR.g, EDIT_COLOR.b, 255);
+        SDL_RenderFillRect(renderer, &cursor);
+    }
 
     SDL_RenderSetClipRect(renderer, nullptr);
 
@@ -259,192 +389,323 @@ void MathVisualizer::renderPanel()
         cursorBlink = SDL_GetTicks();
 }
 
-void MathVisualizer::renderEquations()
+void MathVisualizer::renderGrid()
 {
-    struct tools
+    // 网格和刻度只随视图范围变化
+    if (gridStale || !(gridRange == currentRange))
     {
-        static bool isundef(double value) 
-        {
-            return std::isnan(value) || std::isinf(value);
-        }
-        static int lerp(double a, double b, size_t size)
-        {
-            return static_cast<int>(std::round(a * size / (a - b)));
-        }
-        static void marching_squares(SDL_Renderer*renderer,size_t sx,size_t sy,size_t step,double v11,double v12,double v21,double v22)
-        {
-            if(isundef(v11)||isundef(v12)||isundef(v21)||isundef(v22))
-                return ;
-
-            const char state =
-                ((v11 >= 0) ? 1 : 0) |
-                ((v12 >= 0) ? 2 : 0) |
-                ((v21 >= 0) ? 4 : 0) |
-                ((v22 >= 0) ? 8 : 0);
+        SDL_SetRenderTarget(renderer, gridLayer);
+        SDL_SetRenderDrawColor(renderer, Constants::BACKGROUND_COLOR.r, Constants::BACKGROUND_COLOR.g, Constants::BACKGROUND_COLOR.b, 255);
+        SDL_RenderClear(renderer);
+        Profiler::Scope scope(profiler, "grid");
+        drawCoordinateGrid(renderer, atlas, labels, currentRange);
+        SDL_SetRenderTarget(renderer, nullptr);
+        gridRange = currentRange;
+        gridStale = false;
+    }
+    const SDL_Rect area{0, 0, currentRange.width, currentRange.height};
+    SDL_RenderCopy(renderer, gridLayer, nullptr, &area);
+}
 
-            if (state == 0 || state == 0b1111)
-                return;
+void MathVisualizer::renderRegions()
+{
+    // 所有方程的不等式区域先在 CPU 缓冲中合成, 只在某个方程的区域变化时重新上传
+    std::vector<Equation>& equations = itemList.getEquations();
+    const std::vector<PlotResult>& plots = plotter.frame().results;
+    regionsShown = false;
+    for (size_t i = 0; i < equations.size() && !regionsShown; ++i)
+        if (layers[i].visible)
+            for (const PlotTile& tile : plots[i].tiles)
+                if (!tile.fills.empty())
+                {
+                    regionsShown = true;
+                    break;
+                }
+    if (!regionsShown)
+        return;
 
-            switch (state)
-            {
-            case 0b0001:
-            case 0b1110:
-                SDL_RenderDrawLine(renderer, sx + lerp(v11, v12, step), sy, sx, sy + lerp(v11, v21, step));
-                break;
-            case 0b0010:
-            case 0b1101:
-                SDL_RenderDrawLine(renderer, sx + lerp(v11, v12, step), sy, sx + step, sy + lerp(v12, v22, step));
-                break;
-            case 0b0100:
-            case 0b1011:
-                SDL_RenderDrawLine(renderer, sx + lerp(v21, v22, step), sy + step, sx, sy + lerp(v11, v21, step));
-                break;
-            case 0b1000:
-            case 0b0111:
-                SDL_RenderDrawLine(renderer, sx + lerp(v21, v22, step), sy + step, sx + step, sy + lerp(v12, v22, step));
-                break;
-            case 0b0011:
-            case 0b1100:
-                SDL_RenderDrawLine(renderer, sx, sy + lerp(v11, v21, step), sx + step, sy + lerp(v12, v22, step));
-                break;
-            case 0b1010:
-            case 0b0101:
-                SDL_RenderDrawLine(renderer, sx + lerp(v11, v12, step), sy, sx + lerp(v21, v22, step), sy + step);
-                break;
-            case 0b0110:
-                SDL_RenderDrawLine(renderer, sx + lerp(v11, v12, step), sy, sx + step, sy + lerp(v12, v22, step));
-                SDL_RenderDrawLine(renderer, sx + lerp(v21, v22, step), sy + step, sx, sy + lerp(v11, v21, step));
-                break;
-            case 0b1001:
-                SDL_RenderDrawLine(renderer, sx + lerp(v11, v12, step), sy, sx, sy + lerp(v11, v21, step));
-                SDL_RenderDrawLine(renderer, sx + lerp(v21, v22, step), sy + step, sx + step, sy + lerp(v12, v22, step));
-                break;
-            }
-        }
-    };
+    void* pixels = nullptr;
+    int pitch = 0;
+    if (SDL_LockTexture(regionTexture, nullptr, &pixels, &pitch) != 0)
+    {
+        regionsShown = false;
+        return;
+    }
+    for (int y = 0; y < currentRange.height; ++y)
+        std::memset(static_cast<Uint8*>(pixels) + y * pitch, 0, currentRange.width * sizeof(Uint32));
+    for (size_t i = 0; i < equations.size(); ++i)
+    {
+        const Equation& eq = equations[i];
+        if (!layers[i].visible)
+            continue;
+        const SDL_Color color{eq.color.r, eq.color.g, eq.color.b, static_cast<Uint8>(eq.color.a * Constants::REGION_ALPHA / 255)};
+        for (const PlotTile& tile : plots[i].tiles)
+            blendRects(pixels, pitch, tile.fills, color);
+    }
+    SDL_UnlockTexture(regionTexture);
+}
 
-    const size_t rows = cubes.size();
-    const size_t cols = cubes.front().size();
-    Point2D temp_point;
+void MathVisualizer::renderLayer(const Equation& eq, const PlotResult& plot, Layer& layer)
+{
+    if (!layer.texture)
+    {
+        layer.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, currentRange.width, currentRange.height);
+        if (!layer.texture)
+            return;
+        // 在透明图层上做 BLEND 混合得到的是预乘 alpha 的颜色, 合成时不能再乘一次 alpha
+        const SDL_BlendMode premultiplied = SDL_ComposeCustomBlendMode(
+            SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+            SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+        if (SDL_SetTextureBlendMode(layer.texture, premultiplied) != 0)
+            SDL_SetTextureBlendMode(layer.texture, SDL_BLENDMODE_BLEND);
+        // 映射到缩放后的视图时线性插值
+        SDL_SetTextureScaleMode(layer.texture, SDL_ScaleModeLinear);
+    }
 
-    for (Equation &eq : itemList.getEquations())
+    SDL_SetRenderTarget(renderer, layer.texture);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    if (!plot.shaded)
     {
-        if(!eq.shown||eq.type==RelationalOperator::INVALID)
-            continue;
+        // 拼接化简后的折线合并成一批几何体, 每个方程只提交一次
+        lines.clear();
+        for (size_t i = 0; i < plot.contours.size(); ++i)
+            lines.addPolyline(plot.contours.line(i), plot.contours.length(i), eq.color);
+        lines.draw(renderer);
+    }
+    else
+    {
+        // 按覆盖率分级混合绘制抗锯齿曲线
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        for (int level = 0; level < Constants::SHADE_LEVELS; ++level)
+        {
+            const Uint8 alpha = static_cast<Uint8>(eq.color.a * (level + 1) / Constants::SHADE_LEVELS);
+            SDL_SetRenderDrawColor(renderer, eq.color.r, eq.color.g, eq.color.b, alpha);
+            for (const PlotTile& tile : plot.tiles)
+                if (!tile.shades[level].empty())
+                    SDL_RenderDrawPoints(renderer, tile.shades[level].data(), static_cast<int>(tile.shades[level].size()));
+        }
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    }
+    SDL_SetRenderTarget(renderer, nullptr);
+}
 
-        SDL_SetRenderDrawColor(renderer, eq.color.r, eq.color.g, eq.color.b, eq.color.a);
+void MathVisualizer::drawLayer(SDL_Texture* texture, const MathRange& range)
+{
+    const SDL_Rect area{0, 0, currentRange.width, currentRange.height};
+    if (range == currentRange)
+    {
+        SDL_RenderCopy(renderer, texture, nullptr, &area);
+        return;
+    }
+    // 按 range 绘制的图层仿射映射到当前视图, 只提交落在绘图区内的部分, 纹理坐标按比例截取
+    const Point2D a = mathToScreen({range.xMin, range.yMax}, currentRange);
+    const Point2D b = mathToScreen({range.xMax, range.yMin}, currentRange);
+    const double x0 = std::max(a.x, 0.0);
+    const double y0 = std::max(a.y, 0.0);
+    const double x1 = std::min(b.x, static_cast<double>(area.w));
+    const double y1 = std::min(b.y, static_cast<double>(area.h));
+    if (!(x0 < x1 && y0 < y1))
+        return;
+    const float u0 = static_cast<float>((x0 - a.x) / (b.x - a.x));
+    const float u1 = static_cast<float>((x1 - a.x) / (b.x - a.x));
+    const float v0 = static_cast<float>((y0 - a.y) / (b.y - a.y));
+    const float v1 = static_cast<float>((y1 - a.y) / (b.y - a.y));
+    const SDL_Color white{255, 255, 255, 255};
+    const SDL_Vertex vertices[4] = {
+        {{static_cast<float>(x0), static_cast<float>(y0)}, white, {u0, v0}},
+        {{static_cast<float>(x1), static_cast<float>(y0)}, white, {u1, v0}},
+        {{static_cast<float>(x1), static_cast<float>(y1)}, white, {u1, v1}},
+        {{static_cast<float>(x0), static_cast<float>(y1)}, white, {u0, v1}},
+    };
+    const int indices[6] = {0, 1, 2, 0, 2, 3};
+    SDL_RenderGeometry(renderer, texture, vertices, 4, indices, 6);
+}
 
-        try
+void MathVisualizer::renderEquations()
+{
+    std::vector<Equation>& equations = itemList.getEquations();
+    {
+        // 只提交快照并取最新的结果, 计算在后台线程上进行.
+        // 拖动或缩放时补不完的方程不临时计算粗网格, 先把上一次的图层映射到新视图, 新结果出来后替换
+        Profiler::Scope scope(profiler, "submit");
+        const bool moving = isDragging || SDL_GetTicks() < settleTime;
+        const int selected = itemList.getSelected();
+        const size_t focus = selected < 0 ? eval::size_max : static_cast<size_t>(selected);
+        plotter.submit(equations, currentRange, itemList.getPreview(), focus, moving);
+        if (plotter.acquire())
         {
-            for (size_t ypos = 0, y = 0; ypos < rows; ypos++, y += lstep)
-            {
-                for (size_t xpos = 0, x = 0; xpos < cols; xpos++, x += lstep)
+            // 计算耗时分散在后台的多个线程上, 按累加值单独统计
+            const PlotCost& cost = plotter.lastCost();
+            profiler.add("plot", cost.busyTime);
+            for (size_t i = 0; i < cost.sampleTime.size(); ++i)
+                if (cost.sampleTime[i] > 0.0 || cost.contourTime[i] > 0.0)
                 {
-                    if (xpos % ffts || ypos % ffts)
-                    {
-                        cubes[ypos][xpos] = std::numeric_limits<double>::max();
-                        continue;
-                    }
-                    temp_point = screenToMath(x, y, currentRange);
-                    xNode->data->value = temp_point.x;
-                    yNode->data->value = temp_point.y;
-                    cubes[ypos][xpos] = Equation::evaluator.evaluate(eq.value);
-
-                    if (eq.type == RelationalOperator::NOT_EQUAL)
-                    {
-                        if (std::abs(cubes[ypos][xpos]) <= 1e16)
-                            SDL_RenderDrawPoint(renderer, x, y);
-                    }
-                    else if (eq.type == RelationalOperator::GREATER_THAN || eq.type == RelationalOperator::GREATER_THAN_OR_EQUAL)
-                    {
-                        if (cubes[ypos][xpos] > 0)
-                            SDL_RenderDrawPoint(renderer, x, y);
-                    }
-                    else if (eq.type == RelationalOperator::LESS_THAN || eq.type == RelationalOperator::LESS_THAN_OR_EQUAL)
-                    {
-                        if (cubes[ypos][xpos] < 0)
-                            SDL_RenderDrawPoint(renderer, x, y);
-                    }
+                    const std::string name = "eq " + std::to_string(i + 1);
+                    profiler.add(name + " sample", cost.sampleTime[i]);
+                    profiler.add(name + " contour", cost.contourTime[i]);
                 }
-            }
-            if (eq.type == RelationalOperator::EQUAL || eq.type == RelationalOperator::GREATER_THAN_OR_EQUAL || eq.type == RelationalOperator::LESS_THAN_OR_EQUAL)
-            {
-                for (size_t ypos = 0, y = 0; ypos < rows-ffts; ypos+=ffts, y += step)
-                {
-                    for (size_t xpos = 0, x = 0; xpos < cols-ffts; xpos+=ffts, x += step)
-                    {
-                        const char state =
-                            ((cubes[ypos][xpos] >= 0) ? 1 : 0) |
-                            ((cubes[ypos][xpos + ffts] >= 0) ? 2 : 0) |
-                            ((cubes[ypos + ffts][xpos] >= 0) ? 4 : 0) |
-                            ((cubes[ypos + ffts][xpos + ffts] >= 0) ? 8 : 0);
-    
-                        if (state == 0 || state == 0b1111)
-                            continue;
-    
-                        for (size_t lypos = ypos, count_y = 0, ly = y; count_y <= ffts; count_y++, lypos++, ly += lstep)
-                            for (size_t lxpos = xpos, count_x = 0, lx = x; count_x <= ffts; count_x++, lxpos++, lx += lstep)
-                            {
-                                if(cubes[lypos][lxpos]==std::numeric_limits<double>::max())
-                                {
-                                    temp_point = screenToMath(lx,ly,currentRange);
-                                    xNode->data->value = temp_point.x;
-                                    yNode->data->value = temp_point.y;
-                                    cubes[lypos][lxpos] = Equation::evaluator.evaluate(eq.value);
-                                }
-                                    if(count_x&&count_y)
-                                        tools::marching_squares(renderer,lx-lstep,ly-lstep,lstep,cubes[lypos-1][lxpos-1],cubes[lypos-1][lxpos],cubes[lypos][lxpos-1],cubes[lypos][lxpos]);
-                            }
-                    }
-                }
-            }   
         }
-        catch(...)
+    }
+    Profiler::Scope scope(profiler, "layers");
+    const std::vector<PlotResult>& plots = plotter.frame().results;
+    // 方程增删后结果可能还对应旧的方程列表, 这时只使用程序相同的结果
+    const bool aligned = plots.size() == equations.size();
+
+    // 只重画结果、颜色或可见性变化了的方程图层, 区域缓冲在任一方程变化时整体重新合成
+    bool regions = layers.size() != equations.size();
+    for (size_t i = equations.size(); i < layers.size(); ++i)
+        SDL_DestroyTexture(layers[i].texture);
+    layers.resize(equations.size());
+    for (size_t i = 0; i < equations.size(); ++i)
+    {
+        Equation& eq = equations[i];
+        const PlotResult* plot = i < plots.size() && (aligned || plots[i].program == eq.program) ? &plots[i] : nullptr;
+        if (plot && plot->costProgram == eq.program)
+            eq.cost = plot->cost;
+        // 失败可能只发生在某个视图里, 不改动方程本身, 之后同一程序画成功时清除错误
+        if (plot && plot->program == eq.program)
         {
-            eq.type = RelationalOperator::INVALID;
+            if (!plot->failed)
+                eq.error.clear();
+            else if (eq.error != plot->error)
+            {
+                eq.error = plot->error;
+                SDL_Log("equation %zu failed: %s", i + 1, eq.error.c_str());
+            }
+        }
+        const bool visible = plot && !plot->failed && eq.shown && eq.type != RelationalOperator::INVALID;
+        const size_t revision = plot ? plot->revision : 0;
+        Layer& layer = layers[i];
+        const bool recolored = layer.color.r != eq.color.r || layer.color.g != eq.color.g || layer.color.b != eq.color.b || layer.color.a != eq.color.a;
+        if (layer.revision == revision && layer.visible == visible && !recolored)
             continue;
+        layer.revision = revision;
+        layer.visible = visible;
+        layer.color = eq.color;
+        regions = true;
+        if (visible)
+        {
+            layer.range = plot->range;
+            renderLayer(eq, *plot, layer);
         }
     }
+    // 有方程还停留在旧视图时不重新合成, 上一次合成的区域和曲线图层一起映射到新视图
+    regionsStale = regionsStale || regions;
+    bool current = true;
+    for (const Layer& layer : layers)
+        if (layer.visible && !(layer.range == currentRange))
+            current = false;
+    if (regionsStale && current)
+    {
+        renderRegions();
+        regionRange = currentRange;
+        regionsStale = false;
+    }
+
+    if (regionsShown)
+        drawLayer(regionTexture, regionRange);
+    for (const Layer& layer : layers)
+        if (layer.visible && layer.texture)
+            drawLayer(layer.texture, layer.range);
 }
 
-void MathVisualizer::render()
+int MathVisualizer::idleTimeout() const
+{
+    // 后台线程算出新结果时由事件唤醒; 滚轮停止 SETTLE_DELAY 后要按静止的视图重新提交;
+    // 编辑时光标每 500ms 切换一次, 预览在停止输入 PREVIEW_DELAY 后升级为完整精度
+    const Uint32 now = SDL_GetTicks();
+    const int settle = now < settleTime ? static_cast<int>(settleTime - now) : -1;
+    if (!itemList.isEditing())
+        return settle;
+    const int blink = static_cast<int>(now - cursorBlink);
+    int timeout = blink < 500 ? 500 - blink : std::max(0, 1001 - blink);
+    if (itemList.getPreview() != eval::size_max)
+        timeout = std::min(timeout, static_cast<int>(itemList.getLastEdit() + Constants::PREVIEW_DELAY - now));
+    return settle < 0 ? timeout : std::min(timeout, settle);
+}
+
+void MathVisualizer::renderFrame()
 {
     using namespace Constants;
     SDL_SetRenderDrawColor(renderer, BACKGROUND_COLOR.r, BACKGROUND_COLOR.g, BACKGROUND_COLOR.b, 255);
     SDL_RenderClear(renderer);
 
-    SDL_Rect graphArea{0, 0, panelX, WINDOW_HEIGHT};
-    SDL_RenderSetClipRect(renderer, &graphArea);
-    drawCoordinateGrid(renderer, font, currentRange);
+    renderGrid();
     renderEquations();
-    SDL_RenderSetClipRect(renderer, nullptr);
+}
+
+void MathVisualizer::renderHud()
+{
+    // 各阶段最近若干帧耗时的中位数、95 分位和最大值 (毫秒)
+    const std::vector<Profiler::Stat> stats = profiler.stats();
+    const int lineHeight = atlas.height();
+    const SDL_Rect background{Constants::MARGIN, Constants::MARGIN, 330, lineHeight * static_cast<int>(stats.size() + 1) + 10};
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
+    SDL_RenderFillRect(renderer, &background);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+    const float x = static_cast<float>(background.x + 5);
+    float y = static_cast<float>(background.y + 5);
+    const float columns[] = {x + 140, x + 200, x + 260};
+    const char* headers[] = {"p50", "p95", "max"};
+    atlas.add("stage (ms)", x, y, Constants::TEXT_COLOR);
+    for (int k = 0; k < 3; ++k)
+        atlas.add(headers[k], columns[k], y, Constants::TEXT_COLOR);
+    for (const Profiler::Stat& stat : stats)
+    {
+        y += lineHeight;
+        atlas.add(stat.name, x, y, Constants::TEXT_COLOR, 1.0f, x, columns[0] - 5);
+        const double values[] = {stat.p50, stat.p95, stat.max};
+        for (int k = 0; k < 3; ++k)
+            atlas.add(formatNumber(values[k], 2), columns[k], y, Constants::TEXT_COLOR);
+    }
+    atlas.flush();
+}
 
-    renderPanel();
+void MathVisualizer::render()
+{
+    renderFrame();
+    // 面板和浮层按窗口坐标绘制
+    SDL_RenderSetScale(renderer, pixelScale, pixelScale);
+    {
+        Profiler::Scope scope(profiler, "panel");
+        renderPanel();
+    }
+    if (hudShown)
+        renderHud();
+    SDL_RenderSetScale(renderer, 1.0f, 1.0f);
+    Profiler::Scope scope(profiler, "present");
     SDL_RenderPresent(renderer);
 }
 
 void MathVisualizer::run()
 {
-    const Uint32 targetDelay = 1000 / 60;
-    Uint32 frameStart, frameTime;
-    
     while (isRunning)
     {
-        frameStart = SDL_GetTicks();
+        if (redraw)
+        {
+            redraw = false;
+            render();
+        }
         handleEvents();
-        render();
-        
-        frameTime = SDL_GetTicks() - frameStart;
-        if (frameTime < targetDelay)
-            SDL_Delay(targetDelay - frameTime);
+        profiler.endFrame();
     }
 }
 
 void MathVisualizer::cleanup()
 {
+    plotter.stop();
+    atlas.destroy();
     TTF_CloseFont(font);
+    for (const Layer& layer : layers)
+        SDL_DestroyTexture(layer.texture);
+    SDL_DestroyTexture(gridLayer);
+    SDL_DestroyTexture(regionTexture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
+    SDL_FreeSurface(canvas);
     TTF_Quit();
     SDL_Quit();
 }
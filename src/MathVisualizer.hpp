@@ -2,44 +2,94 @@
 #include "ItemList.hpp"
 #include "MathUtils.hpp"
 #include "RenderUtils.hpp"
+#include "PlotThread.hpp"
+#include "Profiler.hpp"
 
 class MathVisualizer
 {
 private:
+    // 单个方程的曲线图层, 结果、颜色和可见性都未变时直接复用; 视图变化后在新结果出来之前映射到新视图上显示
+    struct Layer
+    {
+        SDL_Texture* texture = nullptr;
+        size_t revision = 0;
+        // 图层内容对应的视图
+        MathRange range;
+        SDL_Color color{0, 0, 0, 0};
+        bool visible = false;
+    };
+
     SDL_Window* window = nullptr;
+    // 无窗口模式下软件渲染器绘制的目标
+    SDL_Surface* canvas = nullptr;
     SDL_Renderer* renderer = nullptr;
+    SDL_Texture* regionTexture = nullptr;
+    SDL_Texture* gridLayer = nullptr;
     TTF_Font* font = nullptr;
     MathRange currentRange{-15.0, 15.0, -10.0, 10.0};
     ItemList itemList;
     bool isRunning = true;
+    bool redraw = true;
+    bool gridStale = true;
+    bool regionsShown = false;
+    bool regionsStale = true;
+    MathRange regionRange;
     bool isDragging = false;
     Point2D dragStart{0.0, 0.0};
     MathRange dragStartRange{-15.0, 15.0, -10.0, 10.0};
-    int panelX = 1200;
+    // 面板和事件使用窗口坐标, 绘图区使用渲染器的实际像素, 两者之比为 pixelScale
+    int panelX = Constants::WINDOW_WIDTH - Constants::PANEL_WIDTH;
+    int windowHeight = Constants::WINDOW_HEIGHT;
+    float pixelScale = 1.0f;
     Uint32 cursorBlink = 0;
+    // 滚轮缩放后在这个时刻之前仍视为正在移动视图
+    Uint32 settleTime = 0;
     int visibleItems = 0;
+    // 默认画质、普通屏幕下的采样密度
+    size_t baseLstep;
+    size_t baseFfts;
+    int quality = Constants::DEFAULT_QUALITY;
 
-    size_t ffts = 2u;
-    size_t lstep = 5u;
-    size_t step;
-    decltype(Equation::evaluator.vars->search("x")) xNode;
-    decltype(Equation::evaluator.vars->search("y")) yNode;
-
-    std::vector<std::vector<double>> cubes;
+    PlotThread plotter;
+    LineBatch lines;
+    GlyphAtlas atlas;
+    LabelCache labels;
+    MathRange gridRange;
+    std::vector<Layer> layers;
+    Profiler profiler;
+    // F3 切换各阶段耗时的浮层, F4 把最近的计时事件导出为 Chrome trace
+    bool hudShown = false;
 
+    bool setup(const char* fontPath, bool requireFont);
+    bool resize();
+    void updateDensity();
     void renderText(const std::string& text, int x, int y, int maxWidth);
     void renderPanel();
+    void renderGrid();
+    void renderRegions();
+    void renderLayer(const Equation& eq, const PlotResult& plot, Layer& layer);
+    void drawLayer(SDL_Texture* texture, const MathRange& range);
     void renderEquations();
+    void renderHud();
+    int idleTimeout() const;
     void handlePanelClick(const SDL_MouseButtonEvent& e);
 
 public:
-    MathVisualizer():
-        xNode(nullptr),
-        yNode(nullptr),
-        cubes(Constants::WINDOW_HEIGHT/lstep+1,std::vector<double>(panelX/lstep+1)),
-        step(lstep*ffts)
+    MathVisualizer(size_t lstep = 5u, size_t ffts = 2u):
+        baseLstep(lstep),
+        baseFfts(ffts),
+        plotter(currentRange.width, currentRange.height, lstep, ffts)
     {}
     bool init();
+    // 不创建窗口, 用软件渲染器画到内存中; 字体打不开时不画刻度文字
+    bool initHeadless(const char* fontPath = Constants::FONT_PATH);
+    // 只取 range 的数学范围, 像素尺寸由窗口决定
+    void setRange(const MathRange& range);
+    bool addEquation(const std::string& expression, SDL_Color color);
+    // 画出网格和所有方程, 不含右侧面板
+    void renderFrame();
+    // 一次画完所有方程, 把绘图区写成 PPM 文件, 扩展名为 .bmp 时写成 BMP
+    bool renderToFile(const std::string& path);
     void handleEvents();
     void render();
     void run();
@@ -0,0 +1,194 @@
+#include "PlotThread.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    bool sameRequest(const PlotRequest& request, const std::vector<Equation>& equations, const MathRange& view, size_t preview, size_t focus, bool moving)
+    {
+        if (!(request.view == view) || request.preview != preview || request.focus != focus || request.moving != moving || request.equations.size() != equations.size())
+            return false;
+        for (size_t i = 0; i < equations.size(); ++i)
+        {
+            const Equation& a = request.equations[i];
+            const Equation& b = equations[i];
+            if (a.program != b.program || a.type != b.type || a.shown != b.shown || a.form != b.form || a.function != b.function)
+                return false;
+        }
+        return true;
+    }
+}
+
+PlotThread::PlotThread(int width, int height, size_t lstep, size_t ffts):
+    plotter(width, height, lstep, ffts),
+    lstep(lstep),
+    ffts(ffts)
+{
+}
+
+PlotThread::~PlotThread()
+{
+    stop();
+}
+
+void PlotThread::bind(const double* x, const double* y)
+{
+    plotter.bind(x, y);
+}
+
+void PlotThread::setDensity(size_t lstep, size_t ffts)
+{
+    if (!thread.joinable())
+    {
+        plotter.setDensity(lstep, ffts);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->lstep = lstep;
+        this->ffts = ffts;
+        requested = true;
+    }
+    wake.notify_one();
+}
+
+void PlotThread::start(Uint32 wakeEvent)
+{
+    this->wakeEvent = wakeEvent;
+    stopping = false;
+    thread = std::thread(&PlotThread::loop, this);
+}
+
+void PlotThread::stop()
+{
+    if (!thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void PlotThread::submit(const std::vector<Equation>& equations, const MathRange& view, size_t preview, size_t focus, bool moving)
+{
+    if (!thread.joinable())
+    {
+        if (sameRequest(request, equations, view, preview, focus, moving))
+            return;
+        request = {equations, view, preview, focus, moving};
+        step(request, std::numeric_limits<double>::infinity());
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (sameRequest(request, equations, view, preview, focus, moving))
+            return;
+        request = {equations, view, preview, focus, moving};
+        requested = true;
+    }
+    wake.notify_one();
+}
+
+bool PlotThread::acquire()
+{
+    // 先清除标记再取, 取之后才发布的结果会再推送一次事件
+    notified = false;
+    if (!(middle.load(std::memory_order_acquire) & FRESH))
+        return false;
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+
+    // 与上一次取到的累计值相减, 方程增删导致序号错位时不计负值
+    const PlotFrame& latest = frames[front];
+    const size_t count = latest.sampleTime.size();
+    seenSample.resize(count, 0.0);
+    seenContour.resize(count, 0.0);
+    cost.sampleTime.resize(count);
+    cost.contourTime.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        cost.sampleTime[i] = std::max(0.0, latest.sampleTime[i] - seenSample[i]);
+        cost.contourTime[i] = std::max(0.0, latest.contourTime[i] - seenContour[i]);
+    }
+    cost.busyTime = latest.busyTime - seenBusy;
+    seenSample = latest.sampleTime;
+    seenContour = latest.contourTime;
+    seenBusy = latest.busyTime;
+    return true;
+}
+
+void PlotThread::loop()
+{
+    PlotRequest current;
+    bool finished = true;
+    while (true)
+    {
+        {
+            // 没有新快照且结果都已补全时休眠; 补全途中每片之间检查一次新快照, 新视图优先
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || requested || !finished; });
+            if (stopping)
+                return;
+            if (requested)
+            {
+                current = request;
+                requested = false;
+            }
+            plotter.setDensity(lstep, ffts);
+        }
+        finished = step(current, Constants::PLOT_BUDGET);
+        if (!notified.exchange(true))
+        {
+            SDL_Event event{};
+            event.type = wakeEvent;
+            SDL_PushEvent(&event);
+        }
+    }
+}
+
+bool PlotThread::step(const PlotRequest& current, double budget)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const bool finished = plotter.plot(current.equations, current.view, results, {current.preview, current.focus, budget, current.moving});
+    publish(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    return finished;
+}
+
+void PlotThread::publish(double busy)
+{
+    // 这一份缓冲上次写入后没变的方程不用再复制; 每次改动结果都会增加 revision 或替换 program
+    totalSample.resize(results.size(), 0.0);
+    totalContour.resize(results.size(), 0.0);
+    totalBusy += busy;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        totalSample[i] += results[i].sampleTime;
+        totalContour[i] += results[i].contourTime;
+    }
+    PlotFrame& out = frames[back];
+    out.sampleTime = totalSample;
+    out.contourTime = totalContour;
+    out.busyTime = totalBusy;
+    out.results.resize(results.size());
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const PlotResult& result = results[i];
+        PlotResult& copy = out.results[i];
+        copy.cost = result.cost;
+        copy.costProgram = result.costProgram;
+        if (copy.revision == result.revision && copy.program == result.program && copy.failed == result.failed)
+            continue;
+        copy.tiles = result.tiles;
+        copy.contours = result.contours;
+        copy.failed = result.failed;
+        copy.error = result.error;
+        copy.preview = result.preview;
+        copy.shaded = result.shaded;
+        copy.revision = result.revision;
+        copy.type = result.type;
+        copy.program = result.program;
+        copy.range = result.range;
+    }
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+}
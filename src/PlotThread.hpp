@@ -0,0 +1,94 @@
+#pragma once
+#include "EquationPlotter.hpp"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// 提交给后台线程的视图和方程的快照
+struct PlotRequest
+{
+    std::vector<Equation> equations;
+    MathRange view;
+    size_t preview = eval::size_max;
+    size_t focus = eval::size_max;
+    bool moving = false;
+};
+
+// 后台线程发布的一份结果, results 与提交时的方程一一对应; 耗时是线程启动以来的累计值 (毫秒)
+struct PlotFrame
+{
+    std::vector<PlotResult> results;
+    std::vector<double> sampleTime;
+    std::vector<double> contourTime;
+    double busyTime = 0.0;
+};
+
+// 相邻两次取到的结果之间花费的计算时间 (毫秒)
+struct PlotCost
+{
+    std::vector<double> sampleTime;
+    std::vector<double> contourTime;
+    double busyTime = 0.0;
+};
+
+// 在后台线程上运行 EquationPlotter: UI 线程提交快照, 后台线程每补全一片就把结果写入三份缓冲中空闲的一份,
+// 再原子地与中间一份交换发布; UI 线程取走最新的一份合成, 双方都不等待对方
+class PlotThread
+{
+private:
+    // FRESH 位表示中间一份是尚未取走的新结果
+    static constexpr unsigned FRESH = 4;
+    static constexpr unsigned INDEX = 3;
+
+    EquationPlotter plotter;
+    // 后台线程独占的结果, 含采样缓存和补全进度
+    std::vector<PlotResult> results;
+    std::vector<double> totalSample;
+    std::vector<double> totalContour;
+    double totalBusy = 0.0;
+    std::array<PlotFrame, 3> frames;
+    std::atomic<unsigned> middle{1};
+    unsigned back = 0;
+    unsigned front = 2;
+    PlotCost cost;
+    std::vector<double> seenSample;
+    std::vector<double> seenContour;
+    double seenBusy = 0.0;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    // 最近一次提交的快照, 后台线程取走时复制一份
+    PlotRequest request;
+    bool requested = false;
+    bool stopping = false;
+    size_t lstep;
+    size_t ffts;
+    Uint32 wakeEvent = 0;
+    // 已推送唤醒事件但 UI 线程还没有来取
+    std::atomic<bool> notified{false};
+
+    void loop();
+    bool step(const PlotRequest& current, double budget);
+    void publish(double busy);
+
+public:
+    PlotThread(int width, int height, size_t lstep = 5u, size_t ffts = 2u);
+    ~PlotThread();
+    PlotThread(const PlotThread&) = delete;
+    PlotThread& operator=(const PlotThread&) = delete;
+
+    void bind(const double* x, const double* y);
+    void setDensity(size_t lstep, size_t ffts);
+    // 启动后台线程, 每次发布新结果时向事件队列推送一个 wakeEvent 类型的事件; 没有启动时 submit 在调用线程上一次画完
+    void start(Uint32 wakeEvent);
+    void stop();
+    // 提交新的快照, 与上一次提交的快照相同时忽略
+    void submit(const std::vector<Equation>& equations, const MathRange& view, size_t preview, size_t focus, bool moving);
+    // 换入最新发布的结果, 没有新结果时返回 false
+    bool acquire();
+    const PlotFrame& frame() const { return frames[front]; }
+    const PlotCost& lastCost() const { return cost; }
+};
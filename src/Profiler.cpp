@@ -0,0 +1,93 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <fstream>
+
+Profiler::Stage& Profiler::stage(const std::string& name)
+{
+    // 阶段只有十几个, 线性查找即可
+    for (Stage& s : stages)
+        if (s.name == name)
+            return s;
+    stages.emplace_back();
+    stages.back().name = name;
+    return stages.back();
+}
+
+void Profiler::push(Event event)
+{
+    if (events.size() == MAX_EVENTS)
+        events.pop_front();
+    events.push_back(std::move(event));
+}
+
+void Profiler::record(const std::string& name, Clock::time_point start, Clock::time_point end)
+{
+    const double duration = std::chrono::duration<double, std::micro>(end - start).count();
+    Stage& s = stage(name);
+    s.current += duration / 1000.0;
+    s.touched = true;
+    push({name, std::chrono::duration<double, std::micro>(start - origin).count(), duration, false});
+}
+
+void Profiler::add(const std::string& name, double ms)
+{
+    Stage& s = stage(name);
+    s.current += ms;
+    s.touched = true;
+    push({name, std::chrono::duration<double, std::micro>(Clock::now() - origin).count(), ms * 1000.0, true});
+}
+
+void Profiler::endFrame()
+{
+    for (Stage& s : stages)
+    {
+        if (!s.touched)
+            continue;
+        if (s.history.size() < HISTORY)
+            s.history.push_back(s.current);
+        else
+            s.history[s.next] = s.current;
+        s.next = (s.next + 1) % HISTORY;
+        s.current = 0.0;
+        s.touched = false;
+    }
+}
+
+std::vector<Profiler::Stat> Profiler::stats() const
+{
+    std::vector<Stat> result;
+    std::vector<double> sorted;
+    for (const Stage& s : stages)
+    {
+        if (s.history.empty())
+            continue;
+        sorted = s.history;
+        std::sort(sorted.begin(), sorted.end());
+        const size_t last = sorted.size() - 1;
+        result.push_back({s.name, sorted[last / 2], sorted[last * 95 / 100], sorted[last]});
+    }
+    return result;
+}
+
+bool Profiler::exportTrace(const std::string& path) const
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    // 计时事件画成时间线上的区间, 累加的开销画成计数器
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const Event& event : events)
+    {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        if (event.counter)
+            out << "{\"name\":\"" << event.name << "\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" << event.start
+                << ",\"args\":{\"ms\":" << event.duration / 1000.0 << "}}";
+        else
+            out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << event.start
+                << ",\"dur\":" << event.duration << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+// 帧内各阶段的计时: 按帧累计每个阶段的耗时并保留最近若干帧用于统计分位数,
+// 同时保留最近的计时事件, 可以导出为 Chrome trace (chrome://tracing, Perfetto) 查看
+class Profiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 作用域计时器, 析构时记录一段耗时
+    class Scope
+    {
+    private:
+        Profiler& profiler;
+        const char* name;
+        Clock::time_point start;
+
+    public:
+        Scope(Profiler& profiler, const char* name):
+            profiler(profiler),
+            name(name),
+            start(Clock::now())
+        {}
+        ~Scope() { profiler.record(name, start, Clock::now()); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    struct Stat
+    {
+        std::string name;
+        double p50;
+        double p95;
+        double max;
+    };
+
+    void record(const std::string& name, Clock::time_point start, Clock::time_point end);
+    // 记录不对应一段连续时间的开销 (毫秒), 例如各线程上累加的计算时间
+    void add(const std::string& name, double ms);
+    // 把本帧各阶段的累计耗时计入历史; 本帧没有运行的阶段不计入
+    void endFrame();
+    // 各阶段最近 HISTORY 帧耗时的分位数 (毫秒), 按阶段第一次出现的顺序
+    std::vector<Stat> stats() const;
+    bool exportTrace(const std::string& path) const;
+
+private:
+    static constexpr size_t HISTORY = 120;
+    static constexpr size_t MAX_EVENTS = 100000;
+
+    struct Stage
+    {
+        std::string name;
+        std::vector<double> history;
+        size_t next = 0;
+        double current = 0.0;
+        bool touched = false;
+    };
+
+    // 时间以微秒计, 从 origin 开始
+    struct Event
+    {
+        std::string name;
+        double start;
+        double duration;
+        bool counter;
+    };
+
+    Clock::time_point origin = Clock::now();
+    std::vector<Stage> stages;
+    std::deque<Event> events;
+
+    Stage& stage(const std::string& name);
+    void push(Event event);
+};
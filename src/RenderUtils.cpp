@@ -1,20 +1,23 @@
 #include "RenderUtils.hpp"
 
-void drawCoordinateGrid(SDL_Renderer* renderer, TTF_Font* font, const MathRange& range)
+void drawCoordinateGrid(SDL_Renderer* renderer, GlyphAtlas& atlas, LabelCache& labels, const MathRange& range)
 {
     using namespace Constants;
     const double baseGridSize = std::pow(10.0, std::floor(std::log10(range.xSpan())));
     const double gridSize = baseGridSize/2;
     const int precision = std::max(0, 3 - static_cast<int>(std::log10(gridSize)));
 
-    SDL_SetRenderDrawColor(renderer, GRID_COLOR.r, GRID_COLOR.g, GRID_COLOR.b, GRID_COLOR.a);
+    // 网格线都是水平或竖直的, 收集成一像素宽的矩形一次提交
+    std::vector<SDL_Rect> lines;
     for (double x = std::ceil(range.xMin / gridSize) * gridSize; x <= range.xMax; x += gridSize)
     {
         if (std::abs(x) < 1e-10)
             continue;
         Point2D p1 = mathToScreen({x, range.yMin}, range);
         Point2D p2 = mathToScreen({x, range.yMax}, range);
-        SDL_RenderDrawLine(renderer, round(p1.x), round(p1.y), round(p2.x), round(p2.y));
+        const int top = static_cast<int>(round(std::min(p1.y, p2.y)));
+        const int bottom = static_cast<int>(round(std::max(p1.y, p2.y)));
+        lines.push_back({static_cast<int>(round(p1.x)), top, 1, bottom - top + 1});
     }
 
     for (double y = std::ceil(range.yMin / gridSize) * gridSize; y <= range.yMax; y += gridSize)
@@ -23,8 +26,12 @@ void drawCoordinateGrid(SDL_Renderer* renderer, TTF_Font* font, const MathRange&
             continue;
         Point2D p1 = mathToScreen({range.xMin, y}, range);
         Point2D p2 = mathToScreen({range.xMax, y}, range);
-        SDL_RenderDrawLine(renderer, round(p1.x), round(p1.y), round(p2.x), round(p2.y));
+        const int left = static_cast<int>(round(std::min(p1.x, p2.x)));
+        const int right = static_cast<int>(round(std::max(p1.x, p2.x)));
+        lines.push_back({left, static_cast<int>(round(p1.y)), right - left + 1, 1});
     }
+    SDL_SetRenderDrawColor(renderer, GRID_COLOR.r, GRID_COLOR.g, GRID_COLOR.b, GRID_COLOR.a);
+    SDL_RenderFillRects(renderer, lines.data(), static_cast<int>(lines.size()));
 
     SDL_SetRenderDrawColor(renderer, AXIS_COLOR.r, AXIS_COLOR.g, AXIS_COLOR.b, AXIS_COLOR.a);
     Point2D xStart = mathToScreen({range.xMin, 0}, range);
@@ -34,35 +41,113 @@ void drawCoordinateGrid(SDL_Renderer* renderer, TTF_Font* font, const MathRange&
     SDL_RenderDrawLine(renderer, xStart.x, xStart.y, xEnd.x, xEnd.y);
     SDL_RenderDrawLine(renderer, yStart.x, yStart.y, yEnd.x, yEnd.y);
 
-    for (double x = std::ceil(range.xMin / gridSize) * gridSize; x <= range.xMax; x += gridSize)
+    // 刻度文字按网格序号缓存, 网格间距变化时整体作废
+    if (labels.gridSize != gridSize || labels.labels.size() > 4096)
     {
-        if (std::abs(x) < 1e-10)
-            continue;
-        Point2D p = mathToScreen({x, 0}, range);
-        std::string label = formatNumber(x, precision);
-        SDL_Surface* surface = TTF_RenderUTF8_Blended(font, label.c_str(), TEXT_COLOR);
-        if (!surface)
-            continue;
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_Rect rect = {static_cast<int>(p.x) - surface->w/2, static_cast<int>(p.y) + 5, surface->w, surface->h};
-        SDL_RenderCopy(renderer, texture, nullptr, &rect);
-        SDL_FreeSurface(surface);
-        SDL_DestroyTexture(texture);
+        labels.labels.clear();
+        labels.gridSize = gridSize;
     }
+    auto label = [&](long long index) -> const LabelCache::Label&
+    {
+        auto it = labels.labels.find(index);
+        if (it == labels.labels.end())
+        {
+            std::string text = formatNumber(index * gridSize, precision);
+            const int width = atlas.measure(text);
+            it = labels.labels.emplace(index, LabelCache::Label{std::move(text), width}).first;
+        }
+        return it->second;
+    };
 
-    for (double y = std::ceil(range.yMin / gridSize) * gridSize; y <= range.yMax; y += gridSize)
+    for (long long k = static_cast<long long>(std::ceil(range.xMin / gridSize)); k * gridSize <= range.xMax; ++k)
     {
-        if (std::abs(y) < 1e-10)
+        if (k == 0)
             continue;
-        Point2D p = mathToScreen({0, y}, range);
-        std::string label = formatNumber(y, precision);
-        SDL_Surface* surface = TTF_RenderUTF8_Blended(font, label.c_str(), TEXT_COLOR);
-        if (!surface)
+        const Point2D p = mathToScreen({k * gridSize, 0}, range);
+        const LabelCache::Label& text = label(k);
+        atlas.add(text.text, static_cast<float>(static_cast<int>(p.x) - text.width / 2), static_cast<float>(static_cast<int>(p.y) + 5), TEXT_COLOR);
+    }
+
+    for (long long k = static_cast<long long>(std::ceil(range.yMin / gridSize)); k * gridSize <= range.yMax; ++k)
+    {
+        if (k == 0)
             continue;
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_Rect rect = {static_cast<int>(p.x) - surface->w -5, static_cast<int>(p.y) - surface->h/2, surface->w, surface->h};
-        SDL_RenderCopy(renderer, texture, nullptr, &rect);
-        SDL_FreeSurface(surface);
-        SDL_DestroyTexture(texture);
+        const Point2D p = mathToScreen({0, k * gridSize}, range);
+        const LabelCache::Label& text = label(k);
+        atlas.add(text.text, static_cast<float>(static_cast<int>(p.x) - text.width - 5), static_cast<float>(static_cast<int>(p.y) - atlas.height() / 2), TEXT_COLOR);
+    }
+    atlas.flush();
+}
+
+void blendRects(void* pixels, int pitch, const std::vector<SDL_Rect>& rects, SDL_Color color)
+{
+    const Uint32 a = color.a;
+    const Uint32 fresh = (a << 24) | (static_cast<Uint32>(color.r) << 16) | (static_cast<Uint32>(color.g) << 8) | color.b;
+    for (const SDL_Rect& rect : rects)
+    {
+        for (int y = rect.y; y < rect.y + rect.h; ++y)
+        {
+            Uint32* row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pixels) + y * pitch);
+            for (int x = rect.x; x < rect.x + rect.w; ++x)
+            {
+                const Uint32 dst = row[x];
+                const Uint32 da = dst >> 24;
+                if (da == 0)
+                {
+                    row[x] = fresh;
+                    continue;
+                }
+                // 源在上的 over 混合: outA = a + da * (1 - a)
+                const Uint32 under = da * (255 - a);
+                const Uint32 outA = a * 255 + under;
+                auto channel = [&](int shift, Uint8 src)
+                {
+                    return (src * a * 255 + ((dst >> shift) & 0xFF) * under) / outA;
+                };
+                row[x] = ((outA / 255) << 24) | (channel(16, color.r) << 16) | (channel(8, color.g) << 8) | channel(0, color.b);
+            }
+        }
     }
-}
\ No newline at end of file
+}
+
+void LineBatch::clear()
+{
+    vertices.clear();
+    indices.clear();
+}
+
+void LineBatch::add(int x1, int y1, int x2, int y2, SDL_Color color, float width)
+{
+    // 像素 (x, y) 的中心在 (x + 0.5, y + 0.5)
+    const float ax = x1 + 0.5f, ay = y1 + 0.5f;
+    const float bx = x2 + 0.5f, by = y2 + 0.5f;
+    const float length = std::hypot(bx - ax, by - ay);
+    const float half = width / 2;
+    float dx = half, dy = 0.0f;
+    if (length > 0.0f)
+    {
+        dx = (bx - ax) / length * half;
+        dy = (by - ay) / length * half;
+    }
+    // 沿方向延长半个线宽作为方头, 相邻线段在端点处不会留缝
+    const int base = static_cast<int>(vertices.size());
+    vertices.push_back({{ax - dx - dy, ay - dy + dx}, color, {0.0f, 0.0f}});
+    vertices.push_back({{ax - dx + dy, ay - dy - dx}, color, {0.0f, 0.0f}});
+    vertices.push_back({{bx + dx + dy, by + dy - dx}, color, {0.0f, 0.0f}});
+    vertices.push_back({{bx + dx - dy, by + dy + dx}, color, {0.0f, 0.0f}});
+    for (int i : {0, 1, 2, 0, 2, 3})
+        indices.push_back(base + i);
+}
+
+void LineBatch::addPolyline(const SDL_Point* points, size_t count, SDL_Color color, float width)
+{
+    for (size_t i = 1; i < count; ++i)
+        add(points[i - 1].x, points[i - 1].y, points[i].x, points[i].y, color, width);
+}
+
+void LineBatch::draw(SDL_Renderer* renderer) const
+{
+    if (indices.empty())
+        return;
+    SDL_RenderGeometry(renderer, nullptr, vertices.data(), static_cast<int>(vertices.size()), indices.data(), static_cast<int>(indices.size()));
+}
@@ -1,5 +1,37 @@
 #pragma once
 #include "MathUtils.hpp"
-#include <SDL_ttf.h>
+#include "GlyphAtlas.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
 
-void drawCoordinateGrid(SDL_Renderer* renderer, TTF_Font* font, const MathRange& range);
\ No newline at end of file
+// 坐标轴刻度文字的缓存, 网格间距不变时每个刻度只格式化和测量一次
+struct LabelCache
+{
+    struct Label
+    {
+        std::string text;
+        int width;
+    };
+    double gridSize = 0.0;
+    std::unordered_map<long long, Label> labels;
+};
+
+void drawCoordinateGrid(SDL_Renderer* renderer, GlyphAtlas& atlas, LabelCache& labels, const MathRange& range);
+// 把互不重叠的矩形以 color 混合进 ARGB8888 像素缓冲, 缓冲中保存的是非预乘的 alpha
+void blendRects(void* pixels, int pitch, const std::vector<SDL_Rect>& rects, SDL_Color color);
+
+// 可复用的线段顶点缓冲, 每段线扩展成带方头的四边形, 整批用一次 SDL_RenderGeometry 提交
+class LineBatch
+{
+private:
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+
+public:
+    void clear();
+    // 端点为像素坐标, 与 SDL_RenderDrawLine 一致
+    void add(int x1, int y1, int x2, int y2, SDL_Color color, float width = 1.0f);
+    void addPolyline(const SDL_Point* points, size_t count, SDL_Color color, float width = 1.0f);
+    void draw(SDL_Renderer* renderer) const;
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+
+class ThreadPool
+{
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<size_t> items;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t, size_t)>* task = nullptr;
+    std::atomic<size_t> pending{0};
+    size_t generation = 0;
+    size_t active = 0;
+    bool stopping = false;
+
+    bool next(size_t worker, size_t& item);
+    void work(size_t worker);
+    void loop(size_t worker);
+
+public:
+    explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return queues.size(); }
+    void parallelFor(size_t count, const std::function<void(size_t index, size_t worker)>& body);
+};
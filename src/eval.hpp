@@ -2,12 +2,22 @@
 #define EVAL_HPP
 
 #include <map>
+#include <set>
+#include <deque>
+#include <cstdint>
+#include <type_traits>
 #include <string>
+#include <string_view>
 #include <functional>
 #include <vector>
 #include <memory>
 #include <stdexcept>
 #include <limits>
+#include <algorithm>
+#include <cmath>
+#include "eval_simd.hpp"
+#include "eval_interval.hpp"
+#include "eval_dual.hpp"
 
 namespace eval
 {
@@ -57,6 +67,12 @@ namespace eval
             return ptr_r == ptr->child.end() ? nullptr : &(ptr_r->second);
         }
 
+        iterator find(iterator node, const CharType &ch) const
+        {
+            auto ptr_r = node->child.find(ch);
+            return ptr_r == node->child.end() ? nullptr : &(ptr_r->second);
+        }
+
         iterator search(const std::basic_string<CharType> &str);
 
         bool erase(const std::basic_string<CharType> &str);
@@ -132,14 +148,363 @@ namespace eval
         }
         return true;
     }
+    // 双数组字典树: 结点 s 经字符 c 转移到 t = base[s] + code(c), 当且仅当 check[t] == s.
+    // 字符先映射为从 1 开始的紧凑编码, 使数组保持稠密; 插入冲突时把冲突结点的子结点整体搬到新的 base.
+    // 迭代器在 insert/erase 之后失效, 数据指针始终保持稳定
+    template <typename CharType, typename DataType>
+    class flat_sstree
+    {
+    public:
+        struct tree_in
+        {
+            std::uint32_t base;
+            std::uint32_t check;
+            DataType *data;
+        };
+        using iterator = const tree_in *;
+
+    private:
+        static constexpr std::uint32_t FREE = std::numeric_limits<std::uint32_t>::max();
+        using UChar = typename std::make_unsigned<CharType>::type;
+
+        std::vector<tree_in> nodes;
+        std::uint32_t narrow[256] = {};
+        std::map<CharType, std::uint32_t> wide;
+        std::uint32_t alphabet = 0;
+        std::set<std::uint32_t> holes;
+        size_t used = 1;
+        std::deque<DataType> values;
+        std::vector<DataType *> released;
+
+        // 单字节字符全部查表, 更宽的字符只有前 256 个查表, 其余查 wide
+        static bool is_narrow(UChar c)
+        {
+            if constexpr (sizeof(CharType) == 1)
+                return true;
+            else
+                return c < 256;
+        }
+        std::uint32_t code(const CharType &ch) const
+        {
+            if (is_narrow(static_cast<UChar>(ch)))
+                return narrow[static_cast<UChar>(ch)];
+            auto it = wide.find(ch);
+            return it == wide.end() ? 0 : it->second;
+        }
+        std::uint32_t add_code(const CharType &ch)
+        {
+            if (std::uint32_t k = code(ch))
+                return k;
+            if (is_narrow(static_cast<UChar>(ch)))
+                return narrow[static_cast<UChar>(ch)] = ++alphabet;
+            return wide[ch] = ++alphabet;
+        }
+        bool is_free(size_t t) const { return t >= nodes.size() || nodes[t].check == FREE; }
+        // 根结点不会是任何结点的子结点, 因此用 0 表示未找到
+        std::uint32_t child(std::uint32_t s, std::uint32_t k) const
+        {
+            const size_t t = size_t(nodes[s].base) + k;
+            return k && t < nodes.size() && nodes[t].check == s ? static_cast<std::uint32_t>(t) : 0;
+        }
+        std::vector<std::uint32_t> children(std::uint32_t s) const
+        {
+            std::vector<std::uint32_t> codes;
+            for (std::uint32_t k = 1; k <= alphabet; ++k)
+                if (child(s, k))
+                    codes.push_back(k);
+            return codes;
+        }
+        void occupy(std::uint32_t t, tree_in node)
+        {
+            if (t >= nodes.size())
+            {
+                for (size_t i = nodes.size(); i < t; ++i)
+                    holes.insert(static_cast<std::uint32_t>(i));
+                nodes.resize(size_t(t) + 1, tree_in{0, FREE, nullptr});
+            }
+            else
+                holes.erase(t);
+            nodes[t] = node;
+            ++used;
+        }
+        void release(std::uint32_t t)
+        {
+            nodes[t] = tree_in{0, FREE, nullptr};
+            holes.insert(t);
+            --used;
+        }
+        // 只在前若干个空洞处尝试, 都放不下时接在数组末尾
+        std::uint32_t find_base(const std::vector<std::uint32_t> &codes) const
+        {
+            size_t tries = 0;
+            for (auto it = holes.lower_bound(codes[0]); it != holes.end() && tries++ < 64; ++it)
+            {
+                const std::uint32_t b = *it - codes[0];
+                bool fits = true;
+                for (std::uint32_t k : codes)
+                    fits = fits && is_free(size_t(b) + k);
+                if (fits)
+                    return b;
+            }
+            return static_cast<std::uint32_t>(std::max<size_t>(nodes.size(), codes[0]) - codes[0]);
+        }
+        // 为 s 选一个能同时容纳已有子结点与编码 k 的 base, 并把已有子结点搬过去
+        void relocate(std::uint32_t s, std::uint32_t k)
+        {
+            std::vector<std::uint32_t> codes = children(s);
+            codes.insert(std::lower_bound(codes.begin(), codes.end(), k), k);
+            const std::uint32_t b = find_base(codes);
+            for (std::uint32_t c : codes)
+            {
+                if (c == k)
+                    continue;
+                const std::uint32_t from = nodes[s].base + c;
+                const std::uint32_t to = b + c;
+                const tree_in moved = nodes[from];
+                occupy(to, tree_in{moved.base, s, moved.data});
+                for (std::uint32_t g : children(from))
+                    nodes[moved.base + g].check = to;
+                release(from);
+            }
+            nodes[s].base = b;
+        }
+
+    public:
+        flat_sstree() : nodes{tree_in{0, 0, nullptr}} {}
+        flat_sstree(const flat_sstree &) = delete;
+        flat_sstree &operator=(const flat_sstree &) = delete;
+
+        iterator begin() const { return nodes.data(); }
+        iterator find(iterator node, const CharType &ch) const
+        {
+            const std::uint32_t t = child(static_cast<std::uint32_t>(node - nodes.data()), code(ch));
+            return t ? nodes.data() + t : nullptr;
+        }
+        iterator search(const std::basic_string<CharType> &str) const
+        {
+            std::uint32_t s = 0;
+            for (const CharType &ch : str)
+                if (!(s = child(s, code(ch))))
+                    return nullptr;
+            return nodes.data() + s;
+        }
+        size_t size() const { return used; }
+        size_t capacity() const { return nodes.capacity(); }
+
+        bool insert(const std::basic_string<CharType> &str, const DataType &data)
+        {
+            std::uint32_t s = 0;
+            for (const CharType &ch : str)
+            {
+                const std::uint32_t k = add_code(ch);
+                std::uint32_t t = child(s, k);
+                if (!t)
+                {
+                    if (!is_free(size_t(nodes[s].base) + k))
+                        relocate(s, k);
+                    t = nodes[s].base + k;
+                    occupy(t, tree_in{0, s, nullptr});
+                }
+                s = t;
+            }
+            if (nodes[s].data)
+                return false;
+            if (released.empty())
+            {
+                values.push_back(data);
+                nodes[s].data = &values.back();
+            }
+            else
+            {
+                *released.back() = data;
+                nodes[s].data = released.back();
+                released.pop_back();
+            }
+            return true;
+        }
+        bool erase(const std::basic_string<CharType> &str)
+        {
+            std::uint32_t s = 0;
+            std::uint32_t last_node = 0;
+            size_t last_branch = 0;
+            for (size_t pos = 0; pos < str.size(); ++pos)
+            {
+                const std::uint32_t t = child(s, code(str[pos]));
+                if (!t)
+                    return false;
+                if (children(s).size() > 1 || nodes[s].data)
+                {
+                    last_node = s;
+                    last_branch = pos;
+                }
+                s = t;
+            }
+            if (nodes[s].data)
+                released.push_back(nodes[s].data);
+            nodes[s].data = nullptr;
+            if (s && children(s).empty())
+            {
+                // 删去 last_node 之下只通向该字符串的整条链
+                for (size_t pos = last_branch; pos < str.size(); ++pos)
+                {
+                    const std::uint32_t t = child(last_node, code(str[pos]));
+                    if (pos > last_branch)
+                        release(last_node);
+                    last_node = t;
+                }
+                release(last_node);
+            }
+            return true;
+        }
+    };
+
+#ifdef EVAL_MAP_SSTREE
+    template <typename CharType, typename DataType>
+    using symbol_table = sstree<CharType, DataType>;
+#else
+    template <typename CharType, typename DataType>
+    using symbol_table = flat_sstree<CharType, DataType>;
+#endif
+
+    enum class opcode : unsigned char
+    {
+        CONST,
+        VAR,
+        LOAD,
+        STORE,
+        CALL,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        POW,
+        MOD,
+        NEG,
+        AFF,
+        SQR,
+        SIN,
+        COS,
+        TAN,
+        ASIN,
+        ACOS,
+        ATAN,
+        ATAN2,
+        SINH,
+        COSH,
+        TANH,
+        ASINH,
+        ACOSH,
+        ATANH,
+        LOG,
+        LG,
+        LN,
+        LOG2,
+        SQRT,
+        CBRT,
+        ABS,
+        EXP,
+        EXP2,
+        CEIL,
+        FLOOR,
+        ROUND,
+        TRUNC,
+        ERF,
+        ERFC,
+        TGAMMA,
+        LGAMMA,
+        HYPOT,
+        ROOT,
+        MIN,
+        MAX
+    };
+
+    inline size_t arity(opcode op)
+    {
+        switch (op)
+        {
+        case opcode::CONST:
+        case opcode::VAR:
+        case opcode::LOAD:
+            return 0;
+        case opcode::ADD:
+        case opcode::SUB:
+        case opcode::MUL:
+        case opcode::DIV:
+        case opcode::POW:
+        case opcode::MOD:
+        case opcode::ATAN2:
+        case opcode::LOG:
+        case opcode::HYPOT:
+        case opcode::ROOT:
+        case opcode::MIN:
+        case opcode::MAX:
+            return 2;
+        default:
+            return 1;
+        }
+    }
+
     template <typename Type>
     struct func
     {
         size_t size;
         size_t priority;
         std::function<Type(const Type *)> func_ptr;
+        opcode code = opcode::CALL;
     };
 
+    template <typename Type>
+    inline Type apply(opcode op, const func<Type> *fn, const Type *args)
+    {
+        switch (op)
+        {
+        case opcode::ADD: return args[0] + args[1];
+        case opcode::SUB: return args[0] - args[1];
+        case opcode::MUL: return args[0] * args[1];
+        case opcode::DIV: return args[0] / args[1];
+        case opcode::POW: return std::pow(args[0], args[1]);
+        case opcode::MOD: return std::fmod(args[0], args[1]);
+        case opcode::NEG: return -args[0];
+        case opcode::AFF: return args[0];
+        case opcode::SQR: return args[0] * args[0];
+        case opcode::SIN: return std::sin(args[0]);
+        case opcode::COS: return std::cos(args[0]);
+        case opcode::TAN: return std::tan(args[0]);
+        case opcode::ASIN: return std::asin(args[0]);
+        case opcode::ACOS: return std::acos(args[0]);
+        case opcode::ATAN: return std::atan(args[0]);
+        case opcode::ATAN2: return std::atan2(args[0], args[1]);
+        case opcode::SINH: return std::sinh(args[0]);
+        case opcode::COSH: return std::cosh(args[0]);
+        case opcode::TANH: return std::tanh(args[0]);
+        case opcode::ASINH: return std::asinh(args[0]);
+        case opcode::ACOSH: return std::acosh(args[0]);
+        case opcode::ATANH: return std::atanh(args[0]);
+        case opcode::LOG: return std::log(args[1]) / std::log(args[0]);
+        case opcode::LG: return std::log10(args[0]);
+        case opcode::LN: return std::log(args[0]);
+        case opcode::LOG2: return std::log2(args[0]);
+        case opcode::SQRT: return std::sqrt(args[0]);
+        case opcode::CBRT: return std::cbrt(args[0]);
+        case opcode::ABS: return std::abs(args[0]);
+        case opcode::EXP: return std::exp(args[0]);
+        case opcode::EXP2: return std::exp2(args[0]);
+        case opcode::CEIL: return std::ceil(args[0]);
+        case opcode::FLOOR: return std::floor(args[0]);
+        case opcode::ROUND: return std::round(args[0]);
+        case opcode::TRUNC: return std::trunc(args[0]);
+        case opcode::ERF: return std::erf(args[0]);
+        case opcode::ERFC: return std::erfc(args[0]);
+        case opcode::TGAMMA: return std::tgamma(args[0]);
+        case opcode::LGAMMA: return std::lgamma(args[0]);
+        case opcode::HYPOT: return std::hypot(args[0], args[1]);
+        case opcode::ROOT: return std::pow(args[1], Type(1) / args[0]);
+        case opcode::MIN: return std::min(args[0], args[1]);
+        case opcode::MAX: return std::max(args[0], args[1]);
+        default: return fn->func_ptr(args);
+        }
+    }
+
     enum class vartype
     {
         CONSTVAR,
@@ -157,7 +522,7 @@ namespace eval
     struct epre
     {
         std::vector<func<Type> *> funcs;
-        std::vector<Type *> vars;
+        std::vector<var<Type> *> vars;
         std::vector<Type> consts;
         std::string index;
         void clear()
@@ -169,38 +534,160 @@ namespace eval
         }
     };
 
+    template <typename Type>
+    struct instr
+    {
+        opcode op;
+        union
+        {
+            Type value;
+            size_t slot;
+            const func<Type> *fn;
+        };
+    };
+
+    template <typename Type>
+    struct program
+    {
+        std::vector<instr<Type>> code;
+        std::vector<const Type *> vars;
+        size_t max_stack = 0;
+        size_t temps = 0;
+
+        size_t slot(const Type *var) const
+        {
+            for (size_t i = 0; i < vars.size(); ++i)
+                if (vars[i] == var)
+                    return i;
+            return size_max;
+        }
+    };
+
+    // 每个线程各自持有的求值状态: 变量槽、求值栈与批量列绑定
+    template <typename Type>
+    struct context
+    {
+        std::vector<Type> values;
+        std::vector<Type> stack;
+        std::vector<const Type *> bound;
+
+        context() = default;
+        explicit context(const program<Type> &prog) { reset(prog); }
+
+        void reset(const program<Type> &prog)
+        {
+            values.resize(prog.vars.size());
+            for (size_t i = 0; i < prog.vars.size(); ++i)
+                values[i] = *prog.vars[i];
+            stack.resize(std::max(stack.size(), prog.max_stack + prog.temps));
+            bound.assign(prog.vars.size(), nullptr);
+        }
+        void set(const program<Type> &prog, const Type *var, Type value)
+        {
+            const size_t slot = prog.slot(var);
+            if (slot != size_max)
+                values[slot] = value;
+        }
+    };
+
+    // 区间求值状态: 每个变量对应一个取值区间, 结果区间包含该区域内所有有定义点的取值
+    template <typename Type>
+    struct interval_context
+    {
+        std::vector<interval<Type>> values;
+        std::vector<interval<Type>> stack;
+
+        interval_context() = default;
+        explicit interval_context(const program<Type> &prog) { reset(prog); }
+
+        void reset(const program<Type> &prog)
+        {
+            values.resize(prog.vars.size());
+            for (size_t i = 0; i < prog.vars.size(); ++i)
+                values[i] = interval<Type>::point(*prog.vars[i]);
+            stack.resize(std::max(stack.size(), prog.max_stack + prog.temps));
+        }
+        void set(const program<Type> &prog, const Type *var, interval<Type> value)
+        {
+            const size_t slot = prog.slot(var);
+            if (slot != size_max)
+                values[slot] = value;
+        }
+    };
+
+    // 前向自动微分求值状态: 每个变量携带值与对 x, y 的偏导数
+    template <typename Type>
+    struct dual_context
+    {
+        std::vector<dual<Type>> values;
+        std::vector<dual<Type>> stack;
+        std::vector<Type> args;
+
+        dual_context() = default;
+        explicit dual_context(const program<Type> &prog) { reset(prog); }
+
+        void reset(const program<Type> &prog)
+        {
+            values.resize(prog.vars.size());
+            for (size_t i = 0; i < prog.vars.size(); ++i)
+                values[i] = dual<Type>::constant(*prog.vars[i]);
+            stack.resize(std::max(stack.size(), prog.max_stack + prog.temps));
+        }
+        void set(const program<Type> &prog, const Type *var, dual<Type> value)
+        {
+            const size_t slot = prog.slot(var);
+            if (slot != size_max)
+                values[slot] = value;
+        }
+    };
+
+    template <typename Type>
+    struct column
+    {
+        const Type *var;
+        const Type *data;
+    };
+
+    constexpr size_t batch_lanes = 256;
+
     template <typename CharType, typename DataType>
     struct evaluator
     {
         using StringType = std::basic_string<CharType>;
+        using ViewType = std::basic_string_view<CharType>;
 
-        std::function<bool(const StringType &,size_t&,epre<DataType> &)> consts;
+        std::function<bool(ViewType,size_t&,epre<DataType> &)> consts;
 
-        std::shared_ptr<sstree<CharType, var<DataType>>> vars;
-        std::shared_ptr<sstree<CharType, func<DataType>>> funcs;
-        std::shared_ptr<sstree<CharType, func<DataType>>> prefix_ops;
-        std::shared_ptr<sstree<CharType, func<DataType>>> infix_ops;
-        std::shared_ptr<sstree<CharType, func<DataType>>> suffix_ops;
+        std::shared_ptr<symbol_table<CharType, var<DataType>>> vars;
+        std::shared_ptr<symbol_table<CharType, func<DataType>>> funcs;
+        std::shared_ptr<symbol_table<CharType, func<DataType>>> prefix_ops;
+        std::shared_ptr<symbol_table<CharType, func<DataType>>> infix_ops;
+        std::shared_ptr<symbol_table<CharType, func<DataType>>> suffix_ops;
 
         evaluator(
-            std::function<bool(const StringType &,size_t&,epre<DataType> &)> consts_,
-            std::shared_ptr<sstree<CharType, var<DataType>>> vars_ = nullptr,
-            std::shared_ptr<sstree<CharType, func<DataType>>> funcs_ = nullptr,
-            std::shared_ptr<sstree<CharType, func<DataType>>> pre_ops = nullptr,
-            std::shared_ptr<sstree<CharType, func<DataType>>> in_ops = nullptr,
-            std::shared_ptr<sstree<CharType, func<DataType>>> suf_ops = nullptr) : consts(consts_),
-                                                                                   vars(vars_ ? vars_ : std::make_shared<sstree<CharType, var<DataType>>>()),
-                                                                                   funcs(funcs_ ? funcs_ : std::make_shared<sstree<CharType, func<DataType>>>()),
-                                                                                   prefix_ops(pre_ops ? pre_ops : std::make_shared<sstree<CharType, func<DataType>>>()),
-                                                                                   infix_ops(in_ops ? in_ops : std::make_shared<sstree<CharType, func<DataType>>>()),
-                                                                                   suffix_ops(suf_ops ? suf_ops : std::make_shared<sstree<CharType, func<DataType>>>())
+            std::function<bool(ViewType,size_t&,epre<DataType> &)> consts_,
+            std::shared_ptr<symbol_table<CharType, var<DataType>>> vars_ = nullptr,
+            std::shared_ptr<symbol_table<CharType, func<DataType>>> funcs_ = nullptr,
+            std::shared_ptr<symbol_table<CharType, func<DataType>>> pre_ops = nullptr,
+            std::shared_ptr<symbol_table<CharType, func<DataType>>> in_ops = nullptr,
+            std::shared_ptr<symbol_table<CharType, func<DataType>>> suf_ops = nullptr) : consts(consts_),
+                                                                                         vars(vars_ ? vars_ : std::make_shared<symbol_table<CharType, var<DataType>>>()),
+                                                                                         funcs(funcs_ ? funcs_ : std::make_shared<symbol_table<CharType, func<DataType>>>()),
+                                                                                         prefix_ops(pre_ops ? pre_ops : std::make_shared<symbol_table<CharType, func<DataType>>>()),
+                                                                                         infix_ops(in_ops ? in_ops : std::make_shared<symbol_table<CharType, func<DataType>>>()),
+                                                                                         suffix_ops(suf_ops ? suf_ops : std::make_shared<symbol_table<CharType, func<DataType>>>())
         {}
-        epre<DataType> parse(const StringType &str);
-        size_t parse(epre<DataType> &expr, const StringType &str) noexcept;
+        epre<DataType> parse(ViewType str);
+        size_t parse(epre<DataType> &expr, ViewType str) noexcept;
         DataType evaluate(const epre<DataType> &expr);
+        program<DataType> compile(const epre<DataType> &expr) const;
+        DataType evaluate(const program<DataType> &prog, context<DataType> &ctx) const;
+        void evaluate_batch(const program<DataType> &prog, context<DataType> &ctx, const column<DataType> *cols, size_t ncols, DataType *out, size_t count) const;
+        interval<DataType> evaluate(const program<DataType> &prog, interval_context<DataType> &ctx) const;
+        dual<DataType> evaluate(const program<DataType> &prog, dual_context<DataType> &ctx) const;
     };
     template <typename CharType, typename DataType>
-    size_t evaluator<CharType,DataType>::parse(epre<DataType> &expr, const StringType &str) noexcept
+    size_t evaluator<CharType,DataType>::parse(epre<DataType> &expr, ViewType str) noexcept
     {
         std::vector<func<DataType> *> op_stack;
         size_t pos = 0;
@@ -226,72 +713,54 @@ namespace eval
                     expecting_operand = false;
                     continue;
                 }
-                typename sstree<CharType, func<DataType>>::iterator it = prefix_ops->find(str[pos]);
+                typename symbol_table<CharType, func<DataType>>::iterator it = prefix_ops->find(prefix_ops->begin(), str[pos]);
                 if (it)
                 {
                     size_t start = pos;
-                    prefix_ops->setptr(it);
                     pos++;
-                    while (pos < str.size() && (it = prefix_ops->find(str[pos])))
-                    {
-                        prefix_ops->setptr(it);
-                        pos++;
-                    }
+                    for (auto next = it; pos < str.size() && (next = prefix_ops->find(it, str[pos])); pos++)
+                        it = next;
 
-                    if (prefix_ops->data())
+                    if (it->data)
                     {
-                        op_stack.push_back(prefix_ops->data());
-                        prefix_ops->rebegin();
+                        op_stack.push_back(it->data);
                         continue;
                     }
-                    prefix_ops->rebegin();
                     pos = start; 
                 }
-                it = funcs->find(str[pos]);
+                it = funcs->find(funcs->begin(), str[pos]);
                 if (it)
                 {
                     size_t start = pos;
-                    funcs->setptr(it);
                     pos++;
-                    while (pos < str.size() && (it = funcs->find(str[pos])))
-                    {
-                        funcs->setptr(it);
-                        pos++;
-                    }
+                    for (auto next = it; pos < str.size() && (next = funcs->find(it, str[pos])); pos++)
+                        it = next;
 
-                    if (pos < str.size() && str[pos] == '(' && funcs->data())
+                    if (pos < str.size() && str[pos] == '(' && it->data)
                     {
-                        op_stack.push_back(funcs->data());
+                        op_stack.push_back(it->data);
                         op_stack.push_back(nullptr); 
                         pos++;                       
                         expecting_operand = true;
-                        funcs->rebegin();
                         continue;
                     }
-                    funcs->rebegin();
                     pos = start; 
                 }
-                typename sstree<CharType, var<DataType>>::iterator var_it = vars->find(str[pos]);
+                typename symbol_table<CharType, var<DataType>>::iterator var_it = vars->find(vars->begin(), str[pos]);
                 if (var_it)
                 {
                     size_t start = pos;
-                    vars->setptr(var_it);
                     pos++;
-                    while (pos < str.size() && (var_it = vars->find(str[pos])))
-                    {
-                        vars->setptr(var_it);
-                        pos++;
-                    }
+                    for (auto next = var_it; pos < str.size() && (next = vars->find(var_it, str[pos])); pos++)
+                        var_it = next;
 
-                    if (vars->data())
+                    if (var_it->data)
                     {
-                        expr.vars.push_back(&vars->data()->value);
+                        expr.vars.push_back(var_it->data);
                         expr.index += 'v';
                         expecting_operand = false;
-                        vars->rebegin();
                         continue;
                     }
-                    vars->rebegin();
                     pos = start; 
                 }
             }
@@ -317,57 +786,45 @@ namespace eval
                     expecting_operand = true;
                     continue;
                 }
-                typename sstree<CharType, func<DataType>>::iterator op_it = infix_ops->find(str[pos]);
+                typename symbol_table<CharType, func<DataType>>::iterator op_it = infix_ops->find(infix_ops->begin(), str[pos]);
                 if (op_it)
                 {
                     size_t start = pos;
-                    infix_ops->setptr(op_it);
                     pos++;
-                    while (pos < str.size() && (op_it = infix_ops->find(str[pos])))
-                    {
-                        infix_ops->setptr(op_it);
-                        pos++;
-                    }
+                    for (auto next = op_it; pos < str.size() && (next = infix_ops->find(op_it, str[pos])); pos++)
+                        op_it = next;
 
-                    if (infix_ops->data())
+                    if (op_it->data)
                     {
                         
                         while (!op_stack.empty() && op_stack.back() != nullptr &&
-                               op_stack.back()->priority >= infix_ops->data()->priority)
+                               op_stack.back()->priority >= op_it->data->priority)
                         {
                             expr.funcs.push_back(op_stack.back());
                             expr.index += 'f';
                             op_stack.pop_back();
                         }
-                        op_stack.push_back(infix_ops->data());
+                        op_stack.push_back(op_it->data);
                         expecting_operand = true;
-                        infix_ops->rebegin();
                         continue;
                     }
-                    infix_ops->rebegin();
                     pos = start; 
                 }
-                op_it = suffix_ops->find(str[pos]);
+                op_it = suffix_ops->find(suffix_ops->begin(), str[pos]);
                 if (op_it)
                 {
                     size_t start = pos;
-                    suffix_ops->setptr(op_it);
                     pos++;
-                    while (pos < str.size() && (op_it = suffix_ops->find(str[pos])))
-                    {
-                        suffix_ops->setptr(op_it);
-                        pos++;
-                    }
+                    for (auto next = op_it; pos < str.size() && (next = suffix_ops->find(op_it, str[pos])); pos++)
+                        op_it = next;
 
-                    if (suffix_ops->data())
+                    if (op_it->data)
                     {
                         
-                        expr.funcs.push_back(suffix_ops->data());
+                        expr.funcs.push_back(op_it->data);
                         expr.index += 'f';
-                        suffix_ops->rebegin();
                         continue;
                     }
-                    suffix_ops->rebegin();
                     pos = start; 
                 }
             }
@@ -388,7 +845,7 @@ namespace eval
         return size_max; 
     }
     template <typename CharType, typename DataType>
-    epre<DataType> evaluator<CharType,DataType>::parse(const StringType &str)
+    epre<DataType> evaluator<CharType,DataType>::parse(ViewType str)
     {
         epre<DataType> expr;
         std::vector<func<DataType> *> op_stack;
@@ -415,72 +872,54 @@ namespace eval
                     expecting_operand = false;
                     continue;
                 }
-                typename sstree<CharType, func<DataType>>::iterator it = prefix_ops->find(str[pos]);
+                typename symbol_table<CharType, func<DataType>>::iterator it = prefix_ops->find(prefix_ops->begin(), str[pos]);
                 if (it)
                 {
                     size_t start = pos;
-                    prefix_ops->setptr(it);
                     pos++;
-                    while (pos < str.size() && (it = prefix_ops->find(str[pos])))
-                    {
-                        prefix_ops->setptr(it);
-                        pos++;
-                    }
+                    for (auto next = it; pos < str.size() && (next = prefix_ops->find(it, str[pos])); pos++)
+                        it = next;
 
-                    if (prefix_ops->data())
+                    if (it->data)
                     {
-                        op_stack.push_back(prefix_ops->data());
-                        prefix_ops->rebegin();
+                        op_stack.push_back(it->data);
                         continue;
                     }
-                    prefix_ops->rebegin();
                     pos = start; 
                 }
-                it = funcs->find(str[pos]);
+                it = funcs->find(funcs->begin(), str[pos]);
                 if (it)
                 {
                     size_t start = pos;
-                    funcs->setptr(it);
                     pos++;
-                    while (pos < str.size() && (it = funcs->find(str[pos])))
-                    {
-                        funcs->setptr(it);
-                        pos++;
-                    }
+                    for (auto next = it; pos < str.size() && (next = funcs->find(it, str[pos])); pos++)
+                        it = next;
 
-                    if (pos < str.size() && str[pos] == '(' && funcs->data())
+                    if (pos < str.size() && str[pos] == '(' && it->data)
                     {
-                        op_stack.push_back(funcs->data());
+                        op_stack.push_back(it->data);
                         op_stack.push_back(nullptr); 
                         pos++;                       
                         expecting_operand = true;
-                        funcs->rebegin();
                         continue;
                     }
-                    funcs->rebegin();
                     pos = start; 
                 }
-                typename sstree<CharType, var<DataType>>::iterator var_it = vars->find(str[pos]);
+                typename symbol_table<CharType, var<DataType>>::iterator var_it = vars->find(vars->begin(), str[pos]);
                 if (var_it)
                 {
                     size_t start = pos;
-                    vars->setptr(var_it);
                     pos++;
-                    while (pos < str.size() && (var_it = vars->find(str[pos])))
-                    {
-                        vars->setptr(var_it);
-                        pos++;
-                    }
+                    for (auto next = var_it; pos < str.size() && (next = vars->find(var_it, str[pos])); pos++)
+                        var_it = next;
 
-                    if (vars->data())
+                    if (var_it->data)
                     {
-                        expr.vars.push_back(&vars->data()->value);
+                        expr.vars.push_back(var_it->data);
                         expr.index += 'v';
                         expecting_operand = false;
-                        vars->rebegin();
                         continue;
                     }
-                    vars->rebegin();
                     pos = start; 
                 }
             }
@@ -506,57 +945,45 @@ namespace eval
                     expecting_operand = true;
                     continue;
                 }
-                typename sstree<CharType, func<DataType>>::iterator op_it = infix_ops->find(str[pos]);
+                typename symbol_table<CharType, func<DataType>>::iterator op_it = infix_ops->find(infix_ops->begin(), str[pos]);
                 if (op_it)
                 {
                     size_t start = pos;
-                    infix_ops->setptr(op_it);
                     pos++;
-                    while (pos < str.size() && (op_it = infix_ops->find(str[pos])))
-                    {
-                        infix_ops->setptr(op_it);
-                        pos++;
-                    }
+                    for (auto next = op_it; pos < str.size() && (next = infix_ops->find(op_it, str[pos])); pos++)
+                        op_it = next;
 
-                    if (infix_ops->data())
+                    if (op_it->data)
                     {
                         
                         while (!op_stack.empty() && op_stack.back() != nullptr &&
-                               op_stack.back()->priority >= infix_ops->data()->priority)
+                               op_stack.back()->priority >= op_it->data->priority)
                         {
                             expr.funcs.push_back(op_stack.back());
                             expr.index += 'f';
                             op_stack.pop_back();
                         }
-                        op_stack.push_back(infix_ops->data());
+                        op_stack.push_back(op_it->data);
                         expecting_operand = true;
-                        infix_ops->rebegin();
                         continue;
                     }
-                    infix_ops->rebegin();
                     pos = start; 
                 }
-                op_it = suffix_ops->find(str[pos]);
+                op_it = suffix_ops->find(suffix_ops->begin(), str[pos]);
                 if (op_it)
                 {
                     size_t start = pos;
-                    suffix_ops->setptr(op_it);
                     pos++;
-                    while (pos < str.size() && (op_it = suffix_ops->find(str[pos])))
-                    {
-                        suffix_ops->setptr(op_it);
-                        pos++;
-                    }
+                    for (auto next = op_it; pos < str.size() && (next = suffix_ops->find(op_it, str[pos])); pos++)
+                        op_it = next;
 
-                    if (suffix_ops->data())
+                    if (op_it->data)
                     {
                         
-                        expr.funcs.push_back(suffix_ops->data());
+                        expr.funcs.push_back(op_it->data);
                         expr.index += 'f';
-                        suffix_ops->rebegin();
                         continue;
                     }
-                    suffix_ops->rebegin();
                     pos = start; 
                 }
             }
@@ -599,7 +1026,7 @@ namespace eval
                 break;
             }
             case 'v':
-                stack.push_back(*expr.vars[var_idx++]);
+                stack.push_back(expr.vars[var_idx++]->value);
                 break;
             case 'c':
                 stack.push_back(expr.consts[const_idx++]);
@@ -612,6 +1039,394 @@ namespace eval
             throw std::runtime_error("Malformed expression");
         return stack.back();
     }
+    template <typename CharType, typename DataType>
+    program<DataType> evaluator<CharType,DataType>::compile(const epre<DataType> &expr) const
+    {
+        program<DataType> prog;
+        size_t depth = 0, func_idx = 0, var_idx = 0, const_idx = 0;
+        prog.code.reserve(expr.index.size());
+        for (char ch : expr.index)
+        {
+            instr<DataType> in;
+            switch (ch)
+            {
+            case 'f':
+            {
+                const func<DataType> *f = expr.funcs[func_idx++];
+                if (depth < f->size)
+                    throw std::runtime_error("Stack underflow");
+                depth = depth - f->size + 1;
+                in.op = f->code;
+                in.fn = f;
+                break;
+            }
+            case 'v':
+            {
+                var<DataType> *v = expr.vars[var_idx++];
+                ++depth;
+                if (v->vtype == vartype::CONSTVAR)
+                {
+                    in.op = opcode::CONST;
+                    in.value = v->value;
+                    break;
+                }
+                in.op = opcode::VAR;
+                in.slot = prog.slot(&v->value);
+                if (in.slot == size_max)
+                {
+                    in.slot = prog.vars.size();
+                    prog.vars.push_back(&v->value);
+                }
+                break;
+            }
+            case 'c':
+                in.op = opcode::CONST;
+                in.value = expr.consts[const_idx++];
+                ++depth;
+                break;
+            default:
+                throw std::runtime_error("Invalid expression index");
+            }
+            prog.max_stack = std::max(prog.max_stack, depth);
+            prog.code.push_back(in);
+        }
+        if (depth != 1)
+            throw std::runtime_error("Malformed expression");
+        return prog;
+    }
+    template <typename CharType, typename DataType>
+    DataType evaluator<CharType,DataType>::evaluate(const program<DataType> &prog, context<DataType> &ctx) const
+    {
+        DataType *sp = ctx.stack.data();
+        DataType *temps = sp + prog.max_stack;
+        for (const instr<DataType> &in : prog.code)
+        {
+            switch (in.op)
+            {
+            case opcode::CONST: *sp++ = in.value; break;
+            case opcode::VAR: *sp++ = ctx.values[in.slot]; break;
+            case opcode::LOAD: *sp++ = temps[in.slot]; break;
+            case opcode::STORE: temps[in.slot] = sp[-1]; break;
+            case opcode::CALL:
+                sp -= in.fn->size;
+                *sp = in.fn->func_ptr(sp);
+                ++sp;
+                break;
+            case opcode::ADD: --sp; sp[-1] = sp[-1] + sp[0]; break;
+            case opcode::SUB: --sp; sp[-1] = sp[-1] - sp[0]; break;
+            case opcode::MUL: --sp; sp[-1] = sp[-1] * sp[0]; break;
+            case opcode::DIV: --sp; sp[-1] = sp[-1] / sp[0]; break;
+            case opcode::NEG: sp[-1] = -sp[-1]; break;
+            case opcode::AFF: break;
+            case opcode::SQR: sp[-1] = sp[-1] * sp[-1]; break;
+            default:
+                sp -= arity(in.op);
+                *sp = apply(in.op, in.fn, sp);
+                ++sp;
+                break;
+            }
+        }
+        return ctx.stack[0];
+    }
+    template <typename CharType, typename DataType>
+    void evaluator<CharType,DataType>::evaluate_batch(const program<DataType> &prog, context<DataType> &ctx, const column<DataType> *cols, size_t ncols, DataType *out, size_t count) const
+    {
+        using lanes::map1;
+        using lanes::map2;
+        constexpr size_t B = batch_lanes;
+        ctx.stack.resize(std::max(ctx.stack.size(), (prog.max_stack + prog.temps) * B));
+        DataType *temps = ctx.stack.data() + prog.max_stack * B;
+        for (size_t i = 0; i < prog.vars.size(); ++i)
+        {
+            ctx.bound[i] = nullptr;
+            for (size_t c = 0; c < ncols; ++c)
+                if (cols[c].var == prog.vars[i])
+                    ctx.bound[i] = cols[c].data;
+        }
+
+        for (size_t base = 0; base < count; base += B)
+        {
+            const size_t n = std::min(B, count - base);
+            DataType *sp = ctx.stack.data();
+            for (const instr<DataType> &in : prog.code)
+            {
+                if (in.op == opcode::CONST)
+                {
+                    std::fill(sp, sp + n, in.value);
+                    sp += B;
+                    continue;
+                }
+                if (in.op == opcode::VAR)
+                {
+                    if (ctx.bound[in.slot])
+                        std::copy(ctx.bound[in.slot] + base, ctx.bound[in.slot] + base + n, sp);
+                    else
+                        std::fill(sp, sp + n, ctx.values[in.slot]);
+                    sp += B;
+                    continue;
+                }
+                if (in.op == opcode::LOAD)
+                {
+                    std::copy(temps + in.slot * B, temps + in.slot * B + n, sp);
+                    sp += B;
+                    continue;
+                }
+                if (in.op == opcode::STORE)
+                {
+                    std::copy(sp - B, sp - B + n, temps + in.slot * B);
+                    continue;
+                }
+                if (in.op == opcode::CALL)
+                {
+                    DataType scalar_args[8];
+                    std::vector<DataType> heap_args;
+                    DataType *fargs = scalar_args;
+                    if (in.fn->size > 8)
+                    {
+                        heap_args.resize(in.fn->size);
+                        fargs = heap_args.data();
+                    }
+                    sp -= in.fn->size * B;
+                    for (size_t l = 0; l < n; ++l)
+                    {
+                        for (size_t i = 0; i < in.fn->size; ++i)
+                            fargs[i] = sp[i * B + l];
+                        sp[l] = in.fn->func_ptr(fargs);
+                    }
+                    sp += B;
+                    continue;
+                }
+                if (arity(in.op) == 2)
+                    sp -= B;
+                DataType *a = sp - B, *b = sp;
+                const DataType *args[2] = {a, b};
+                switch (in.op)
+                {
+                case opcode::ADD: lanes::add<DataType>(args, a, n); break;
+                case opcode::SUB: lanes::sub<DataType>(args, a, n); break;
+                case opcode::MUL: lanes::mul<DataType>(args, a, n); break;
+                case opcode::DIV: lanes::div<DataType>(args, a, n); break;
+                case opcode::POW: map2(a, b, n, [](DataType l, DataType r) { return std::pow(l, r); }); break;
+                case opcode::MOD: map2(a, b, n, [](DataType l, DataType r) { return std::fmod(l, r); }); break;
+                case opcode::NEG: lanes::neg<DataType>(args, a, n); break;
+                case opcode::AFF: break;
+                case opcode::SQR: { const DataType *square[2] = {a, a}; lanes::mul<DataType>(square, a, n); break; }
+                case opcode::SIN: map1(a, n, [](DataType v) { return std::sin(v); }); break;
+                case opcode::COS: map1(a, n, [](DataType v) { return std::cos(v); }); break;
+                case opcode::TAN: map1(a, n, [](DataType v) { return std::tan(v); }); break;
+                case opcode::ASIN: map1(a, n, [](DataType v) { return std::asin(v); }); break;
+                case opcode::ACOS: map1(a, n, [](DataType v) { return std::acos(v); }); break;
+                case opcode::ATAN: map1(a, n, [](DataType v) { return std::atan(v); }); break;
+                case opcode::ATAN2: map2(a, b, n, [](DataType l, DataType r) { return std::atan2(l, r); }); break;
+                case opcode::SINH: map1(a, n, [](DataType v) { return std::sinh(v); }); break;
+                case opcode::COSH: map1(a, n, [](DataType v) { return std::cosh(v); }); break;
+                case opcode::TANH: map1(a, n, [](DataType v) { return std::tanh(v); }); break;
+                case opcode::ASINH: map1(a, n, [](DataType v) { return std::asinh(v); }); break;
+                case opcode::ACOSH: map1(a, n, [](DataType v) { return std::acosh(v); }); break;
+                case opcode::ATANH: map1(a, n, [](DataType v) { return std::atanh(v); }); break;
+                case opcode::LOG: map2(a, b, n, [](DataType l, DataType r) { return std::log(r) / std::log(l); }); break;
+                case opcode::LG: map1(a, n, [](DataType v) { return std::log10(v); }); break;
+                case opcode::LN: map1(a, n, [](DataType v) { return std::log(v); }); break;
+                case opcode::LOG2: map1(a, n, [](DataType v) { return std::log2(v); }); break;
+                case opcode::SQRT: lanes::sqrt<DataType>(args, a, n); break;
+                case opcode::CBRT: map1(a, n, [](DataType v) { return std::cbrt(v); }); break;
+                case opcode::ABS: lanes::abs<DataType>(args, a, n); break;
+                case opcode::EXP: map1(a, n, [](DataType v) { return std::exp(v); }); break;
+                case opcode::EXP2: map1(a, n, [](DataType v) { return std::exp2(v); }); break;
+                case opcode::CEIL: map1(a, n, [](DataType v) { return std::ceil(v); }); break;
+                case opcode::FLOOR: map1(a, n, [](DataType v) { return std::floor(v); }); break;
+                case opcode::ROUND: map1(a, n, [](DataType v) { return std::round(v); }); break;
+                case opcode::TRUNC: map1(a, n, [](DataType v) { return std::trunc(v); }); break;
+                case opcode::ERF: map1(a, n, [](DataType v) { return std::erf(v); }); break;
+                case opcode::ERFC: map1(a, n, [](DataType v) { return std::erfc(v); }); break;
+                case opcode::TGAMMA: map1(a, n, [](DataType v) { return std::tgamma(v); }); break;
+                case opcode::LGAMMA: map1(a, n, [](DataType v) { return std::lgamma(v); }); break;
+                case opcode::HYPOT: map2(a, b, n, [](DataType l, DataType r) { return std::hypot(l, r); }); break;
+                case opcode::ROOT: map2(a, b, n, [](DataType l, DataType r) { return std::pow(r, DataType(1) / l); }); break;
+                case opcode::MIN: lanes::min<DataType>(args, a, n); break;
+                case opcode::MAX: lanes::max<DataType>(args, a, n); break;
+                default: break;
+                }
+            }
+            std::copy(ctx.stack.begin(), ctx.stack.begin() + n, out + base);
+        }
+    }
+    template <typename CharType, typename DataType>
+    interval<DataType> evaluator<CharType,DataType>::evaluate(const program<DataType> &prog, interval_context<DataType> &ctx) const
+    {
+        namespace iv = intervals;
+        using I = interval<DataType>;
+        const DataType inf = std::numeric_limits<DataType>::infinity();
+        I *sp = ctx.stack.data();
+        I *temps = sp + prog.max_stack;
+        for (const instr<DataType> &in : prog.code)
+        {
+            switch (in.op)
+            {
+            case opcode::CONST: *sp++ = I::point(in.value); continue;
+            case opcode::VAR: *sp++ = ctx.values[in.slot]; continue;
+            case opcode::LOAD: *sp++ = temps[in.slot]; continue;
+            case opcode::STORE: temps[in.slot] = sp[-1]; continue;
+            case opcode::CALL:
+                // 没有区间版本的自定义函数只能给出整个实数轴
+                sp -= in.fn->size;
+                *sp++ = I::entire();
+                continue;
+            default:
+                break;
+            }
+            if (arity(in.op) == 2)
+                --sp;
+            I &a = sp[-1];
+            const I &b = sp[0];
+            switch (in.op)
+            {
+            case opcode::ADD: a = iv::add(a, b); break;
+            case opcode::SUB: a = iv::sub(a, b); break;
+            case opcode::MUL: a = iv::mul(a, b); break;
+            case opcode::DIV: a = iv::div(a, b); break;
+            case opcode::POW: a = iv::pow(a, b); break;
+            case opcode::MOD: a = iv::fmod(a, b); break;
+            case opcode::NEG: a = iv::neg(a); break;
+            case opcode::AFF: break;
+            case opcode::SQR: a = iv::sqr(a); break;
+            case opcode::SIN: a = iv::sin(a); break;
+            case opcode::COS: a = iv::cos(a); break;
+            case opcode::TAN: a = iv::tan(a); break;
+            case opcode::ASIN: a = iv::increasing(iv::domain(a, DataType(-1), DataType(1)), [](DataType v) { return std::asin(v); }); break;
+            case opcode::ACOS: a = iv::decreasing(iv::domain(a, DataType(-1), DataType(1)), [](DataType v) { return std::acos(v); }); break;
+            case opcode::ATAN: a = iv::increasing(a, [](DataType v) { return std::atan(v); }); break;
+            case opcode::ATAN2: a = iv::atan2(a, b); break;
+            case opcode::SINH: a = iv::increasing(a, [](DataType v) { return std::sinh(v); }); break;
+            case opcode::COSH: a = iv::cosh(a); break;
+            case opcode::TANH: a = iv::increasing(a, [](DataType v) { return std::tanh(v); }); break;
+            case opcode::ASINH: a = iv::increasing(a, [](DataType v) { return std::asinh(v); }); break;
+            case opcode::ACOSH: a = iv::increasing(iv::domain(a, DataType(1), inf), [](DataType v) { return std::acosh(v); }); break;
+            case opcode::ATANH: a = iv::increasing(iv::domain(a, DataType(-1), DataType(1), true), [](DataType v) { return std::atanh(v); }); break;
+            case opcode::LOG:
+                a = iv::div(iv::increasing(iv::domain(b, DataType(0), inf, true), [](DataType v) { return std::log(v); }),
+                            iv::increasing(iv::domain(a, DataType(0), inf, true), [](DataType v) { return std::log(v); }));
+                break;
+            case opcode::LG: a = iv::increasing(iv::domain(a, DataType(0), inf, true), [](DataType v) { return std::log10(v); }); break;
+            case opcode::LN: a = iv::increasing(iv::domain(a, DataType(0), inf, true), [](DataType v) { return std::log(v); }); break;
+            case opcode::LOG2: a = iv::increasing(iv::domain(a, DataType(0), inf, true), [](DataType v) { return std::log2(v); }); break;
+            case opcode::SQRT: a = iv::increasing(iv::domain(a, DataType(0), inf), [](DataType v) { return std::sqrt(v); }); break;
+            case opcode::CBRT: a = iv::increasing(a, [](DataType v) { return std::cbrt(v); }); break;
+            case opcode::ABS: a = iv::abs(a); break;
+            case opcode::EXP: a = iv::increasing(a, [](DataType v) { return std::exp(v); }); break;
+            case opcode::EXP2: a = iv::increasing(a, [](DataType v) { return std::exp2(v); }); break;
+            case opcode::CEIL: a = iv::increasing(a, [](DataType v) { return std::ceil(v); }); break;
+            case opcode::FLOOR: a = iv::increasing(a, [](DataType v) { return std::floor(v); }); break;
+            case opcode::ROUND: a = iv::increasing(a, [](DataType v) { return std::round(v); }); break;
+            case opcode::TRUNC: a = iv::increasing(a, [](DataType v) { return std::trunc(v); }); break;
+            case opcode::ERF: a = iv::increasing(a, [](DataType v) { return std::erf(v); }); break;
+            case opcode::ERFC: a = iv::decreasing(a, [](DataType v) { return std::erfc(v); }); break;
+            case opcode::TGAMMA: a = iv::gamma_like(a, [](DataType v) { return std::tgamma(v); }, DataType(0.8856031944108886)); break;
+            case opcode::LGAMMA: a = iv::gamma_like(a, [](DataType v) { return std::lgamma(v); }, DataType(-0.12148629053584963)); break;
+            case opcode::HYPOT: a = iv::hypot(a, b); break;
+            case opcode::ROOT: a = iv::pow(b, iv::div(I::point(DataType(1)), a)); break;
+            case opcode::MIN: a = iv::min(a, b); break;
+            case opcode::MAX: a = iv::max(a, b); break;
+            default: a = I::entire(); break;
+            }
+        }
+        return ctx.stack[0];
+    }
+    template <typename CharType, typename DataType>
+    dual<DataType> evaluator<CharType,DataType>::evaluate(const program<DataType> &prog, dual_context<DataType> &ctx) const
+    {
+        namespace dv = duals;
+        using D = dual<DataType>;
+        using T = DataType;
+        D *sp = ctx.stack.data();
+        D *temps = sp + prog.max_stack;
+        for (const instr<DataType> &in : prog.code)
+        {
+            switch (in.op)
+            {
+            case opcode::CONST: *sp++ = D::constant(in.value); continue;
+            case opcode::VAR: *sp++ = ctx.values[in.slot]; continue;
+            case opcode::LOAD: *sp++ = temps[in.slot]; continue;
+            case opcode::STORE: temps[in.slot] = sp[-1]; continue;
+            case opcode::CALL:
+            {
+                // 自定义函数对每个参数做数值微分
+                const size_t n = in.fn->size;
+                sp -= n;
+                ctx.args.resize(n);
+                for (size_t i = 0; i < n; ++i)
+                    ctx.args[i] = sp[i].value;
+                D r = D::constant(in.fn->func_ptr(ctx.args.data()));
+                for (size_t i = 0; i < n; ++i)
+                {
+                    if (sp[i].dx == T(0) && sp[i].dy == T(0))
+                        continue;
+                    const T d = dv::slope([&](T v) { ctx.args[i] = v; return in.fn->func_ptr(ctx.args.data()); }, sp[i].value);
+                    ctx.args[i] = sp[i].value;
+                    r.dx += d * sp[i].dx;
+                    r.dy += d * sp[i].dy;
+                }
+                *sp++ = r;
+                continue;
+            }
+            default:
+                break;
+            }
+            if (arity(in.op) == 2)
+                --sp;
+            D &a = sp[-1];
+            const D &b = sp[0];
+            const T v = a.value;
+            switch (in.op)
+            {
+            case opcode::ADD: a = dv::add(a, b); break;
+            case opcode::SUB: a = dv::sub(a, b); break;
+            case opcode::MUL: a = dv::mul(a, b); break;
+            case opcode::DIV: a = dv::div(a, b); break;
+            case opcode::POW: a = dv::pow(a, b); break;
+            case opcode::MOD: a = dv::fmod(a, b); break;
+            case opcode::NEG: a = {-a.value, -a.dx, -a.dy}; break;
+            case opcode::AFF: break;
+            case opcode::SQR: a = dv::chain(a, v * v, T(2) * v); break;
+            case opcode::SIN: a = dv::chain(a, std::sin(v), std::cos(v)); break;
+            case opcode::COS: a = dv::chain(a, std::cos(v), -std::sin(v)); break;
+            case opcode::TAN: a = dv::chain(a, std::tan(v), T(1) / (std::cos(v) * std::cos(v))); break;
+            case opcode::ASIN: a = dv::chain(a, std::asin(v), T(1) / std::sqrt(T(1) - v * v)); break;
+            case opcode::ACOS: a = dv::chain(a, std::acos(v), -T(1) / std::sqrt(T(1) - v * v)); break;
+            case opcode::ATAN: a = dv::chain(a, std::atan(v), T(1) / (T(1) + v * v)); break;
+            case opcode::ATAN2: a = dv::atan2(a, b); break;
+            case opcode::SINH: a = dv::chain(a, std::sinh(v), std::cosh(v)); break;
+            case opcode::COSH: a = dv::chain(a, std::cosh(v), std::sinh(v)); break;
+            case opcode::TANH: { const T t = std::tanh(v); a = dv::chain(a, t, T(1) - t * t); break; }
+            case opcode::ASINH: a = dv::chain(a, std::asinh(v), T(1) / std::sqrt(v * v + T(1))); break;
+            case opcode::ACOSH: a = dv::chain(a, std::acosh(v), T(1) / std::sqrt(v * v - T(1))); break;
+            case opcode::ATANH: a = dv::chain(a, std::atanh(v), T(1) / (T(1) - v * v)); break;
+            case opcode::LOG: a = dv::log(a, b); break;
+            case opcode::LG: a = dv::chain(a, std::log10(v), T(1) / (v * std::log(T(10)))); break;
+            case opcode::LN: a = dv::chain(a, std::log(v), T(1) / v); break;
+            case opcode::LOG2: a = dv::chain(a, std::log2(v), T(1) / (v * std::log(T(2)))); break;
+            case opcode::SQRT: { const T r = std::sqrt(v); a = dv::chain(a, r, T(0.5) / r); break; }
+            case opcode::CBRT: { const T r = std::cbrt(v); a = dv::chain(a, r, T(1) / (3 * r * r)); break; }
+            case opcode::ABS: a = dv::chain(a, std::abs(v), v < T(0) ? T(-1) : T(1)); break;
+            case opcode::EXP: { const T e = std::exp(v); a = dv::chain(a, e, e); break; }
+            case opcode::EXP2: { const T e = std::exp2(v); a = dv::chain(a, e, e * std::log(T(2))); break; }
+            case opcode::CEIL: a = D::constant(std::ceil(v)); break;
+            case opcode::FLOOR: a = D::constant(std::floor(v)); break;
+            case opcode::ROUND: a = D::constant(std::round(v)); break;
+            case opcode::TRUNC: a = D::constant(std::trunc(v)); break;
+            case opcode::ERF: a = dv::chain(a, std::erf(v), T(2) / std::sqrt(std::acos(T(-1))) * std::exp(-v * v)); break;
+            case opcode::ERFC: a = dv::chain(a, std::erfc(v), -T(2) / std::sqrt(std::acos(T(-1))) * std::exp(-v * v)); break;
+            case opcode::TGAMMA: a = dv::chain(a, std::tgamma(v), dv::slope([](T x) { return std::tgamma(x); }, v)); break;
+            case opcode::LGAMMA: a = dv::chain(a, std::lgamma(v), dv::slope([](T x) { return std::lgamma(x); }, v)); break;
+            case opcode::HYPOT: a = dv::hypot(a, b); break;
+            case opcode::ROOT: a = dv::pow(b, dv::div(D::constant(T(1)), a)); break;
+            case opcode::MIN: a = dv::min(a, b); break;
+            case opcode::MAX: a = dv::max(a, b); break;
+            default: a = D::constant(apply(in.op, in.fn, &v)); break;
+            }
+        }
+        return ctx.stack[0];
+    }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,110 @@
+#ifndef EVAL_DUAL_HPP
+#define EVAL_DUAL_HPP
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace eval
+{
+    // 前向自动微分的对偶数: 同时携带函数值与对 x, y 两个方向的偏导数
+    template <typename T>
+    struct dual
+    {
+        T value;
+        T dx = T(0);
+        T dy = T(0);
+
+        static dual constant(T v) { return {v, T(0), T(0)}; }
+    };
+
+    namespace duals
+    {
+        // 复合函数求导: f(a) 的值为 value, f'(a) 为 slope
+        template <typename T>
+        dual<T> chain(const dual<T> &a, T value, T slope)
+        {
+            return {value, slope * a.dx, slope * a.dy};
+        }
+        // 两个参数的链式法则, da 与 db 分别是对第一、第二个参数的偏导
+        template <typename T>
+        dual<T> chain(const dual<T> &a, const dual<T> &b, T value, T da, T db)
+        {
+            return {value, da * a.dx + db * b.dx, da * a.dy + db * b.dy};
+        }
+        // 没有解析导数的函数用中心差分近似
+        template <typename T, typename F>
+        T slope(F f, T x)
+        {
+            const T h = std::cbrt(std::numeric_limits<T>::epsilon()) * std::max(T(1), std::abs(x));
+            return (f(x + h) - f(x - h)) / (2 * h);
+        }
+
+        template <typename T>
+        dual<T> add(const dual<T> &a, const dual<T> &b)
+        {
+            return {a.value + b.value, a.dx + b.dx, a.dy + b.dy};
+        }
+        template <typename T>
+        dual<T> sub(const dual<T> &a, const dual<T> &b)
+        {
+            return {a.value - b.value, a.dx - b.dx, a.dy - b.dy};
+        }
+        template <typename T>
+        dual<T> mul(const dual<T> &a, const dual<T> &b)
+        {
+            return chain(a, b, a.value * b.value, b.value, a.value);
+        }
+        template <typename T>
+        dual<T> div(const dual<T> &a, const dual<T> &b)
+        {
+            const T q = a.value / b.value;
+            return chain(a, b, q, T(1) / b.value, -q / b.value);
+        }
+        template <typename T>
+        dual<T> pow(const dual<T> &a, const dual<T> &b)
+        {
+            const T v = std::pow(a.value, b.value);
+            // 指数为常数时不经过 log, 负底数的整数次幂也能求导
+            if (b.dx == T(0) && b.dy == T(0))
+                return chain(a, v, b.value * std::pow(a.value, b.value - T(1)));
+            return chain(a, b, v, b.value * std::pow(a.value, b.value - T(1)), v * std::log(a.value));
+        }
+        template <typename T>
+        dual<T> fmod(const dual<T> &a, const dual<T> &b)
+        {
+            return chain(a, b, std::fmod(a.value, b.value), T(1), -std::trunc(a.value / b.value));
+        }
+        template <typename T>
+        dual<T> atan2(const dual<T> &y, const dual<T> &x)
+        {
+            const T r = x.value * x.value + y.value * y.value;
+            return chain(y, x, std::atan2(y.value, x.value), x.value / r, -y.value / r);
+        }
+        template <typename T>
+        dual<T> hypot(const dual<T> &a, const dual<T> &b)
+        {
+            const T h = std::hypot(a.value, b.value);
+            return chain(a, b, h, a.value / h, b.value / h);
+        }
+        template <typename T>
+        dual<T> log(const dual<T> &base, const dual<T> &x)
+        {
+            const T lb = std::log(base.value);
+            const T lx = std::log(x.value);
+            return chain(base, x, lx / lb, -lx / (lb * lb * base.value), T(1) / (lb * x.value));
+        }
+        template <typename T>
+        dual<T> min(const dual<T> &a, const dual<T> &b)
+        {
+            return b.value < a.value ? b : a;
+        }
+        template <typename T>
+        dual<T> max(const dual<T> &a, const dual<T> &b)
+        {
+            return a.value < b.value ? b : a;
+        }
+    }
+}
+
+#endif
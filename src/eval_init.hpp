@@ -1,26 +1,26 @@
 #ifndef EVAL_INIT_HPP
 #define EVAL_INIT_HPP
 #include "eval.hpp"
+#include "eval_optimize.hpp"
 #include <cmath>
+#include <charconv>
+#include <cstdlib>
+#include <string>
+#include <string_view>
 
 namespace eval_init
 {
+    // 直接在原字符串上转换字面量, 溢出时退回 strtod 系列以得到 inf 或 0
     template <typename T>
-    T convert(const std::string &);
-    template <>
-    inline double convert<double>(const std::string &str)
+    const char *convert(const char *first, const char *last, T &value)
     {
-        return std::stod(str);
-    }
-    template <>
-    inline float convert<float>(const std::string &str)
-    {
-        return std::stof(str);
-    }
-    template <>
-    inline long double convert<long double>(const std::string &str)
-    {
-        return std::stold(str);
+        const std::from_chars_result result = std::from_chars(first, last, value);
+        if (result.ec == std::errc::result_out_of_range)
+        {
+            const std::string literal(first, result.ptr);
+            value = static_cast<T>(std::strtold(literal.c_str(), nullptr));
+        }
+        return result.ptr;
     }
 
     template <typename T>
@@ -28,47 +28,55 @@ namespace eval_init
     {
         using namespace eval;
         evaluator<char, T> calc(
-            [](const std::string &str, size_t &pos, epre<T> &expr) -> bool
+            [](std::string_view str, size_t &pos, epre<T> &expr) -> bool
             {
-                if (str[pos] < '0' || str[pos] > '9')
+                auto digit = [&](size_t at)
+                { return at < str.size() && str[at] >= '0' && str[at] <= '9'; };
+                if (!digit(pos))
                     return false;
-                size_t start = pos;
-                while (pos < str.size() && str[pos] >= '0' && str[pos] <= '9')
-                    pos++;
-                if (str[pos] == '.' && str[pos + 1] >= '0' && str[pos + 1] <= '9')
+                size_t end = pos;
+                while (digit(end))
+                    end++;
+                if (end < str.size() && str[end] == '.' && digit(end + 1))
                     do
-                        pos++;
-                    while (pos < str.size() && str[pos] >= '0' && str[pos] <= '9');
-                if (str[pos] == 'e' || str[pos] == 'E')
+                        end++;
+                    while (digit(end));
+                if (end < str.size() && (str[end] == 'e' || str[end] == 'E'))
                 {
-                    pos++;
-                    if (str[pos] == '+' || str[pos] == '-')
-                        pos++;
-                    while (pos < str.size() && str[pos] >= '0' && str[pos] <= '9')
-                        pos++;
+                    size_t exp = end + 1;
+                    if (exp < str.size() && (str[exp] == '+' || str[exp] == '-'))
+                        exp++;
+                    if (digit(exp))
+                    {
+                        end = exp;
+                        while (digit(end))
+                            end++;
+                    }
                 }
-                expr.consts.push_back(convert<T>(str.substr(start, pos - start)));
+                T value;
+                pos = convert(str.data() + pos, str.data() + end, value) - str.data();
+                expr.consts.push_back(value);
                 expr.index += 'c';
                 return true;
             });
 
         // 注册基本运算符
         func<T> add_op{2, 1, [](const T *args)
-                       { return args[0] + args[1]; }};
+                       { return args[0] + args[1]; }, opcode::ADD};
         func<T> sub_op{2, 1, [](const T *args)
-                       { return args[0] - args[1]; }};
+                       { return args[0] - args[1]; }, opcode::SUB};
         func<T> mul_op{2, 2, [](const T *args)
-                       { return args[0] * args[1]; }};
+                       { return args[0] * args[1]; }, opcode::MUL};
         func<T> div_op{2, 2, [](const T *args)
-                       { return args[0] / args[1]; }};
+                       { return args[0] / args[1]; }, opcode::DIV};
         func<T> pow_op{2, 3, [](const T *args)
-                       { return std::pow(args[0], args[1]); }};
+                       { return std::pow(args[0], args[1]); }, opcode::POW};
         func<T> mod_op{2, 2, [](const T *args)
-                       { return std::fmod(args[0], args[1]); }};
+                       { return std::fmod(args[0], args[1]); }, opcode::MOD};
         func<T> neg_op{1, 2, [](const T *args)
-                       { return -args[0]; }};
+                       { return -args[0]; }, opcode::NEG};
         func<T> aff_op{1, 2, [](const T *args)
-                       { return args[0]; }};
+                       { return args[0]; }, opcode::AFF};
 
         calc.infix_ops->insert("+", add_op);
         calc.infix_ops->insert("-", sub_op);
@@ -81,73 +89,73 @@ namespace eval_init
 
         // 注册数学函数
         func<T> sin_op{1, size_max, [](const T *args)
-                       { return std::sin(args[0]); }};
+                       { return std::sin(args[0]); }, opcode::SIN};
         func<T> cos_op{1, size_max, [](const T *args)
-                       { return std::cos(args[0]); }};
+                       { return std::cos(args[0]); }, opcode::COS};
         func<T> tan_op{1, size_max, [](const T *args)
-                       { return std::tan(args[0]); }};
+                       { return std::tan(args[0]); }, opcode::TAN};
         func<T> asin_op{1, size_max, [](const T *args)
-                        { return std::asin(args[0]); }};
+                        { return std::asin(args[0]); }, opcode::ASIN};
         func<T> acos_op{1, size_max, [](const T *args)
-                        { return std::acos(args[0]); }};
+                        { return std::acos(args[0]); }, opcode::ACOS};
         func<T> atan_op{1, size_max, [](const T *args)
-                        { return std::atan(args[0]); }};
+                        { return std::atan(args[0]); }, opcode::ATAN};
         func<T> atan2_op{2, size_max, [](const T *args)
-                         { return std::atan2(args[0], args[1]); }};
+                         { return std::atan2(args[0], args[1]); }, opcode::ATAN2};
         func<T> sinh_op{1, size_max, [](const T *args)
-                        { return std::sinh(args[0]); }};
+                        { return std::sinh(args[0]); }, opcode::SINH};
         func<T> cosh_op{1, size_max, [](const T *args)
-                        { return std::cosh(args[0]); }};
+                        { return std::cosh(args[0]); }, opcode::COSH};
         func<T> tanh_op{1, size_max, [](const T *args)
-                        { return std::tanh(args[0]); }};
+                        { return std::tanh(args[0]); }, opcode::TANH};
         func<T> asinh_op{1, size_max, [](const T *args)
-                        { return std::asinh(args[0]); }};
+                        { return std::asinh(args[0]); }, opcode::ASINH};
         func<T> acosh_op{1, size_max, [](const T *args)
-                        { return std::acosh(args[0]); }};
+                        { return std::acosh(args[0]); }, opcode::ACOSH};
         func<T> atanh_op{1, size_max, [](const T *args)
-                        { return std::atanh(args[0]); }};
+                        { return std::atanh(args[0]); }, opcode::ATANH};
         func<T> log_op{2, size_max, [](const T *args)
-                       { return std::log(args[1]) / std::log(args[0]); }};
+                       { return std::log(args[1]) / std::log(args[0]); }, opcode::LOG};
         func<T> lg_op{1, size_max, [](const T *args)
-                      { return std::log10(args[0]); }};
+                      { return std::log10(args[0]); }, opcode::LG};
         func<T> ln_op{1, size_max, [](const T *args)
-                      { return std::log(args[0]); }};
+                      { return std::log(args[0]); }, opcode::LN};
         func<T> log2_op{1, size_max, [](const T *args)
-                        { return std::log2(args[0]); }};
+                        { return std::log2(args[0]); }, opcode::LOG2};
         func<T> sqrt_op{1, size_max, [](const T *args)
-                        { return std::sqrt(args[0]); }};
+                        { return std::sqrt(args[0]); }, opcode::SQRT};
         func<T> cbrt_op{1, size_max, [](const T *args)
-                        { return std::cbrt(args[0]); }};
+                        { return std::cbrt(args[0]); }, opcode::CBRT};
         func<T> abs_op{1, size_max, [](const T *args)
-                       { return std::abs(args[0]); }};
+                       { return std::abs(args[0]); }, opcode::ABS};
         func<T> exp_op{1, size_max, [](const T *args)
-                       { return std::exp(args[0]); }};
+                       { return std::exp(args[0]); }, opcode::EXP};
         func<T> exp2_op{1, size_max, [](const T *args)
-                        { return std::exp2(args[0]); }};
+                        { return std::exp2(args[0]); }, opcode::EXP2};
         func<T> ceil_op{1, size_max, [](const T *args)
-                        { return std::ceil(args[0]); }};
+                        { return std::ceil(args[0]); }, opcode::CEIL};
         func<T> floor_op{1, size_max, [](const T *args)
-                         { return std::floor(args[0]); }};
+                         { return std::floor(args[0]); }, opcode::FLOOR};
         func<T> round_op{1, size_max, [](const T *args)
-                         { return std::round(args[0]); }};
+                         { return std::round(args[0]); }, opcode::ROUND};
         func<T> trunc_op{1, size_max, [](const T *args)
-                         { return std::trunc(args[0]); }};
+                         { return std::trunc(args[0]); }, opcode::TRUNC};
         func<T> erf_op{1, size_max, [](const T *args)
-                       { return std::erf(args[0]); }};
+                       { return std::erf(args[0]); }, opcode::ERF};
         func<T> erfc_op{1, size_max, [](const T *args)
-                        { return std::erfc(args[0]); }};
+                        { return std::erfc(args[0]); }, opcode::ERFC};
         func<T> tgamma_op{1, size_max, [](const T *args)
-                          { return std::tgamma(args[0]); }};
+                          { return std::tgamma(args[0]); }, opcode::TGAMMA};
         func<T> lgamma_op{1, size_max, [](const T *args)
-                          { return std::lgamma(args[0]); }};
+                          { return std::lgamma(args[0]); }, opcode::LGAMMA};
         func<T> hypot_op{2, size_max, [](const T *args)
-                         { return std::hypot(args[0], args[1]); }};
+                         { return std::hypot(args[0], args[1]); }, opcode::HYPOT};
         func<T> root_op{2, size_max, [](const T *args)
-                        { return std::pow(args[1], T(1) / args[0]); }};
+                        { return std::pow(args[1], T(1) / args[0]); }, opcode::ROOT};
         func<T> min_op{2, size_max, [](const T *args)
-                       { return std::min(args[0], args[1]); }};
+                       { return std::min(args[0], args[1]); }, opcode::MIN};
         func<T> max_op{2, size_max, [](const T *args)
-                       { return std::max(args[0], args[1]); }};
+                       { return std::max(args[0], args[1]); }, opcode::MAX};
 
         calc.funcs->insert("sin", sin_op);
         calc.funcs->insert("cos", cos_op);
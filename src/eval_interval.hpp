@@ -0,0 +1,272 @@
+#ifndef EVAL_INTERVAL_HPP
+#define EVAL_INTERVAL_HPP
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace eval
+{
+    // 闭区间 [lo, hi]; partial 表示区间内可能存在无定义的点, lo > hi 或 NaN 表示处处无定义
+    template <typename T>
+    struct interval
+    {
+        T lo;
+        T hi;
+        bool partial = false;
+
+        static interval point(T v) { return {v, v, false}; }
+        static interval entire() { return {-std::numeric_limits<T>::infinity(), std::numeric_limits<T>::infinity(), true}; }
+        static interval empty() { return {std::numeric_limits<T>::quiet_NaN(), std::numeric_limits<T>::quiet_NaN(), true}; }
+        bool is_empty() const { return !(lo <= hi); }
+        bool contains(T v) const { return lo <= v && v <= hi; }
+    };
+
+    namespace intervals
+    {
+        template <typename T>
+        interval<T> outward(T lo, T hi, bool partial)
+        {
+            if (std::isnan(lo) || std::isnan(hi))
+                return interval<T>::entire();
+            return {std::nextafter(lo, -std::numeric_limits<T>::infinity()),
+                    std::nextafter(hi, std::numeric_limits<T>::infinity()), partial};
+        }
+        template <typename T, typename F>
+        interval<T> increasing(const interval<T> &x, F f)
+        {
+            if (x.is_empty())
+                return x;
+            return outward(f(x.lo), f(x.hi), x.partial);
+        }
+        template <typename T, typename F>
+        interval<T> decreasing(const interval<T> &x, F f)
+        {
+            if (x.is_empty())
+                return x;
+            return outward(f(x.hi), f(x.lo), x.partial);
+        }
+        // 把 x 限制到定义域 [lo, hi], open 为真时端点本身也视为无定义
+        template <typename T>
+        interval<T> domain(const interval<T> &x, T lo, T hi, bool open = false)
+        {
+            if (x.is_empty() || x.hi < lo || x.lo > hi)
+                return interval<T>::empty();
+            const bool cut = x.lo < lo || x.hi > hi || (open && (x.lo <= lo || x.hi >= hi));
+            return {std::max(x.lo, lo), std::min(x.hi, hi), x.partial || cut};
+        }
+        template <typename T>
+        T mig(const interval<T> &x)
+        {
+            if (x.contains(T(0)))
+                return T(0);
+            return std::min(std::abs(x.lo), std::abs(x.hi));
+        }
+        template <typename T>
+        T mag(const interval<T> &x)
+        {
+            return std::max(std::abs(x.lo), std::abs(x.hi));
+        }
+
+        template <typename T>
+        interval<T> add(const interval<T> &a, const interval<T> &b)
+        {
+            if (a.is_empty() || b.is_empty())
+                return interval<T>::empty();
+            return outward(a.lo + b.lo, a.hi + b.hi, a.partial || b.partial);
+        }
+        template <typename T>
+        interval<T> sub(const interval<T> &a, const interval<T> &b)
+        {
+            if (a.is_empty() || b.is_empty())
+                return interval<T>::empty();
+            return outward(a.lo - b.hi, a.hi - b.lo, a.partial || b.partial);
+        }
+        template <typename T>
+        interval<T> mul(const interval<T> &a, const interval<T> &b)
+        {
+            if (a.is_empty() || b.is_empty())
+                return interval<T>::empty();
+            const T p[4] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+            return outward(*std::min_element(p, p + 4), *std::max_element(p, p + 4), a.partial || b.partial);
+        }
+        template <typename T>
+        interval<T> div(const interval<T> &a, const interval<T> &b)
+        {
+            if (a.is_empty() || b.is_empty() || (b.lo == T(0) && b.hi == T(0)))
+                return interval<T>::empty();
+            if (b.contains(T(0)))
+                return interval<T>::entire();
+            const T p[4] = {a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi};
+            return outward(*std::min_element(p, p + 4), *std::max_element(p, p + 4), a.partial || b.partial);
+        }
+        template <typename T>
+        interval<T> neg(const interval<T> &a)
+        {
+            return {-a.hi, -a.lo, a.partial};
+        }
+        template <typename T>
+        interval<T> abs(const interval<T> &a)
+        {
+            if (a.is_empty())
+                return a;
+            return {mig(a), mag(a), a.partial};
+        }
+        // 与 mul(a, a) 不同, 两个因子相同, 跨过 0 时下界是 0
+        template <typename T>
+        interval<T> sqr(const interval<T> &a)
+        {
+            if (a.is_empty())
+                return a;
+            return outward(mig(a) * mig(a), mag(a) * mag(a), a.partial);
+        }
+        template <typename T>
+        interval<T> pow(const interval<T> &a, const interval<T> &b)
+        {
+            if (a.is_empty() || b.is_empty())
+                return interval<T>::empty();
+            if (b.lo == b.hi && b.lo == std::trunc(b.lo) && std::abs(b.lo) < T(1 << 20))
+            {
+                const T n = b.lo;
+                if (n == T(0))
+                    return interval<T>::point(T(1));
+                if (n < T(0))
+                    return div(interval<T>::point(T(1)), pow(a, interval<T>::point(-n)));
+                const bool even = std::fmod(n, T(2)) == T(0);
+                if (!even || a.lo >= T(0))
+                    return outward(std::pow(a.lo, n), std::pow(a.hi, n), a.partial);
+                if (a.hi <= T(0))
+                    return outward(std::pow(a.hi, n), std::pow(a.lo, n), a.partial);
+                return outward(T(0), std::pow(mag(a), n), a.partial);
+            }
+            const interval<T> base = domain(a, T(0), std::numeric_limits<T>::infinity());
+            if (base.is_empty())
+                return base;
+            const T p[4] = {std::pow(base.lo, b.lo), std::pow(base.lo, b.hi), std::pow(base.hi, b.lo), std::pow(base.hi, b.hi)};
+            for (T v : p)
+                if (std::isnan(v))
+                    return interval<T>::entire();
+            return outward(*std::min_element(p, p + 4), *std::max_element(p, p + 4), base.partial || b.partial);
+        }
+        template <typename T>
+        interval<T> fmod(const interval<T> &a, const interval<T> &b)
+        {
+            if (a.is_empty() || b.is_empty())
+                return interval<T>::empty();
+            const T m = mag(b);
+            const bool partial = a.partial || b.partial || b.contains(T(0));
+            if (a.lo >= T(0))
+                return {T(0), std::min(a.hi, m), partial};
+            if (a.hi <= T(0))
+                return {std::max(a.lo, -m), T(0), partial};
+            return {-m, m, partial};
+        }
+        template <typename T>
+        interval<T> cos(const interval<T> &a)
+        {
+            if (a.is_empty())
+                return a;
+            const T pi = std::acos(T(-1));
+            if (!(a.hi - a.lo < 2 * pi))
+                return {T(-1), T(1), a.partial};
+            const T k = std::ceil(a.lo / (2 * pi));
+            const bool top = 2 * pi * k <= a.hi;
+            const bool bottom = pi + 2 * pi * std::ceil((a.lo - pi) / (2 * pi)) <= a.hi;
+            const T c1 = std::cos(a.lo), c2 = std::cos(a.hi);
+            interval<T> r = outward(std::min(c1, c2), std::max(c1, c2), a.partial);
+            if (top)
+                r.hi = T(1);
+            if (bottom)
+                r.lo = T(-1);
+            r.lo = std::max(r.lo, T(-1));
+            r.hi = std::min(r.hi, T(1));
+            return r;
+        }
+        template <typename T>
+        interval<T> sin(const interval<T> &a)
+        {
+            if (a.is_empty())
+                return a;
+            const T pi = std::acos(T(-1));
+            if (!(a.hi - a.lo < 2 * pi))
+                return {T(-1), T(1), a.partial};
+            const bool top = pi / 2 + 2 * pi * std::ceil((a.lo - pi / 2) / (2 * pi)) <= a.hi;
+            const bool bottom = -pi / 2 + 2 * pi * std::ceil((a.lo + pi / 2) / (2 * pi)) <= a.hi;
+            const T s1 = std::sin(a.lo), s2 = std::sin(a.hi);
+            interval<T> r = outward(std::min(s1, s2), std::max(s1, s2), a.partial);
+            if (top)
+                r.hi = T(1);
+            if (bottom)
+                r.lo = T(-1);
+            r.lo = std::max(r.lo, T(-1));
+            r.hi = std::min(r.hi, T(1));
+            return r;
+        }
+        template <typename T>
+        interval<T> tan(const interval<T> &a)
+        {
+            if (a.is_empty())
+                return a;
+            const T pi = std::acos(T(-1));
+            if (!(a.hi - a.lo < pi) || pi / 2 + pi * std::ceil((a.lo - pi / 2) / pi) <= a.hi)
+                return interval<T>::entire();
+            return increasing(a, [](T v) { return std::tan(v); });
+        }
+        template <typename T>
+        interval<T> cosh(const interval<T> &a)
+        {
+            if (a.is_empty())
+                return a;
+            return outward(std::cosh(mig(a)), std::cosh(mag(a)), a.partial);
+        }
+        template <typename T>
+        interval<T> atan2(const interval<T> &y, const interval<T> &x)
+        {
+            if (y.is_empty() || x.is_empty())
+                return interval<T>::empty();
+            const T pi = std::acos(T(-1));
+            if (x.lo <= T(0))
+                return {-pi, pi, y.partial || x.partial};
+            const T p[4] = {std::atan2(y.lo, x.lo), std::atan2(y.lo, x.hi), std::atan2(y.hi, x.lo), std::atan2(y.hi, x.hi)};
+            return outward(*std::min_element(p, p + 4), *std::max_element(p, p + 4), y.partial || x.partial);
+        }
+        template <typename T, typename F>
+        interval<T> gamma_like(const interval<T> &a, F f, T minimum)
+        {
+            // tgamma 与 lgamma 在正半轴上都只在 x0 处取得最小值
+            const T x0 = T(1.4616321449683623);
+            if (a.is_empty())
+                return a;
+            if (a.lo <= T(0))
+                return interval<T>::entire();
+            if (a.lo >= x0)
+                return increasing(a, f);
+            if (a.hi <= x0)
+                return decreasing(a, f);
+            return outward(minimum, std::max(f(a.lo), f(a.hi)), a.partial);
+        }
+        template <typename T>
+        interval<T> hypot(const interval<T> &a, const interval<T> &b)
+        {
+            if (a.is_empty() || b.is_empty())
+                return interval<T>::empty();
+            return outward(std::hypot(mig(a), mig(b)), std::hypot(mag(a), mag(b)), a.partial || b.partial);
+        }
+        template <typename T>
+        interval<T> min(const interval<T> &a, const interval<T> &b)
+        {
+            if (a.is_empty() || b.is_empty())
+                return interval<T>::empty();
+            return {std::min(a.lo, b.lo), std::min(a.hi, b.hi), a.partial || b.partial};
+        }
+        template <typename T>
+        interval<T> max(const interval<T> &a, const interval<T> &b)
+        {
+            if (a.is_empty() || b.is_empty())
+                return interval<T>::empty();
+            return {std::max(a.lo, b.lo), std::max(a.hi, b.hi), a.partial || b.partial};
+        }
+    }
+}
+
+#endif
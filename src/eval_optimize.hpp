@@ -0,0 +1,255 @@
+#ifndef EVAL_OPTIMIZE_HPP
+#define EVAL_OPTIMIZE_HPP
+
+#include "eval.hpp"
+#include <map>
+#include <tuple>
+#include <cstring>
+
+namespace eval
+{
+    // 在编译后的 program 上做常量折叠、强度削减、恒等式消除与公共子表达式合并
+    template <typename Type>
+    class optimizer
+    {
+        struct node
+        {
+            opcode op;
+            Type value;
+            size_t slot;
+            const func<Type> *fn;
+            std::vector<size_t> args;
+        };
+        using key = std::tuple<opcode, std::string, std::vector<size_t>>;
+
+        std::vector<node> nodes;
+        std::map<key, size_t> table;
+
+        template <typename T>
+        static std::string bytes(const T &v)
+        {
+            std::string s(sizeof(T), '\0');
+            std::memcpy(&s[0], &v, sizeof(T));
+            return s;
+        }
+        bool is_const(size_t id) const { return nodes[id].op == opcode::CONST; }
+        bool is_const(size_t id, Type v) const { return is_const(id) && nodes[id].value == v; }
+
+        size_t make(node n)
+        {
+            std::string operand;
+            if (n.op == opcode::CONST)
+                operand = bytes(n.value);
+            else if (n.op == opcode::VAR)
+                operand = bytes(n.slot);
+            else if (n.op == opcode::CALL)
+                operand = bytes(n.fn);
+            key k{n.op, operand, n.args};
+            auto it = table.find(k);
+            if (it != table.end())
+                return it->second;
+            nodes.push_back(std::move(n));
+            table.emplace(std::move(k), nodes.size() - 1);
+            return nodes.size() - 1;
+        }
+        size_t make_const(Type v) { return make({opcode::CONST, v, 0, nullptr, {}}); }
+        size_t make_op(opcode op, std::vector<size_t> args) { return make({op, Type(), 0, nullptr, std::move(args)}); }
+
+        size_t power(size_t base, long n)
+        {
+            if (n < 0)
+                return make_op(opcode::DIV, {make_const(Type(1)), power(base, -n)});
+            if (n == 0)
+                return make_const(Type(1));
+            if (n == 1)
+                return base;
+            size_t half = power(base, n / 2);
+            // 平方单独成一条指令, 区间运算才能知道两个因子相同
+            size_t sq = simplify(opcode::SQR, nullptr, {half});
+            return n % 2 ? simplify(opcode::MUL, nullptr, {sq, base}) : sq;
+        }
+
+        size_t simplify(opcode op, const func<Type> *fn, std::vector<size_t> args)
+        {
+            bool folding = op != opcode::CALL;
+            for (size_t a : args)
+                folding = folding && is_const(a);
+            if (folding)
+            {
+                std::vector<Type> values;
+                for (size_t a : args)
+                    values.push_back(nodes[a].value);
+                return make_const(apply(op, fn, values.data()));
+            }
+
+            switch (op)
+            {
+            case opcode::AFF:
+                return args[0];
+            case opcode::NEG:
+                if (nodes[args[0]].op == opcode::NEG)
+                    return nodes[args[0]].args[0];
+                break;
+            case opcode::ADD:
+                if (is_const(args[1], Type(0)))
+                    return args[0];
+                if (is_const(args[0], Type(0)))
+                    return args[1];
+                if (args[0] > args[1])
+                    std::swap(args[0], args[1]);
+                break;
+            case opcode::SUB:
+                if (is_const(args[1], Type(0)))
+                    return args[0];
+                if (is_const(args[0], Type(0)))
+                    return simplify(opcode::NEG, nullptr, {args[1]});
+                break;
+            case opcode::MUL:
+                if (is_const(args[1], Type(1)))
+                    return args[0];
+                if (is_const(args[0], Type(1)))
+                    return args[1];
+                if (is_const(args[1], Type(-1)))
+                    return simplify(opcode::NEG, nullptr, {args[0]});
+                if (is_const(args[0], Type(-1)))
+                    return simplify(opcode::NEG, nullptr, {args[1]});
+                if (args[0] > args[1])
+                    std::swap(args[0], args[1]);
+                break;
+            case opcode::DIV:
+                if (is_const(args[1], Type(1)))
+                    return args[0];
+                if (is_const(args[1]))
+                {
+                    // 除以 2 的幂可以精确地改写为乘法
+                    int exponent;
+                    const Type mantissa = std::frexp(nodes[args[1]].value, &exponent);
+                    if (mantissa == Type(0.5) || mantissa == Type(-0.5))
+                        return simplify(opcode::MUL, nullptr, {args[0], make_const(Type(1) / nodes[args[1]].value)});
+                }
+                break;
+            case opcode::POW:
+                if (is_const(args[1]))
+                {
+                    const Type n = nodes[args[1]].value;
+                    if (n == std::trunc(n) && std::abs(n) <= Type(4))
+                        return power(args[0], static_cast<long>(n));
+                }
+                break;
+            default:
+                break;
+            }
+            return make({op, Type(), 0, fn, std::move(args)});
+        }
+
+    public:
+        void run(program<Type> &prog)
+        {
+            std::vector<size_t> stack;
+            std::vector<size_t> stored(prog.temps);
+            for (const instr<Type> &in : prog.code)
+            {
+                switch (in.op)
+                {
+                case opcode::CONST:
+                    stack.push_back(make_const(in.value));
+                    break;
+                case opcode::VAR:
+                    stack.push_back(make({opcode::VAR, Type(), in.slot, nullptr, {}}));
+                    break;
+                case opcode::LOAD:
+                    stack.push_back(stored[in.slot]);
+                    break;
+                case opcode::STORE:
+                    stored[in.slot] = stack.back();
+                    break;
+                default:
+                {
+                    const size_t n = in.op == opcode::CALL ? in.fn->size : arity(in.op);
+                    std::vector<size_t> args(stack.end() - n, stack.end());
+                    stack.resize(stack.size() - n);
+                    stack.push_back(simplify(in.op, in.fn, std::move(args)));
+                    break;
+                }
+                }
+            }
+            if (stack.size() != 1)
+                throw std::runtime_error("Malformed expression");
+
+            std::vector<size_t> uses(nodes.size(), 0), order;
+            std::vector<bool> seen(nodes.size(), false);
+            order.push_back(stack.back());
+            seen[stack.back()] = true;
+            for (size_t i = 0; i < order.size(); ++i)
+                for (size_t a : nodes[order[i]].args)
+                {
+                    ++uses[a];
+                    if (!seen[a])
+                    {
+                        seen[a] = true;
+                        order.push_back(a);
+                    }
+                }
+
+            program<Type> out;
+            out.vars = prog.vars;
+            std::vector<size_t> temp(nodes.size(), size_max);
+            size_t depth = 0;
+            auto push = [&](instr<Type> in, long delta)
+            {
+                depth += delta;
+                out.max_stack = std::max(out.max_stack, depth);
+                out.code.push_back(in);
+            };
+            // 后序遍历输出指令; 用显式的栈, 很长的左结合链也不会占用过深的调用栈.
+            // 每项记录结点和下一个要输出的参数, 第一次到达已存入临时槽的结点时直接读取
+            std::vector<std::pair<size_t, size_t>> work{{stack.back(), 0}};
+            while (!work.empty())
+            {
+                const size_t id = work.back().first;
+                const node &n = nodes[id];
+                instr<Type> in;
+                if (work.back().second == 0 && temp[id] != size_max)
+                {
+                    in.op = opcode::LOAD;
+                    in.slot = temp[id];
+                    push(in, 1);
+                    work.pop_back();
+                    continue;
+                }
+                if (work.back().second < n.args.size())
+                {
+                    const size_t arg = n.args[work.back().second++];
+                    work.push_back({arg, 0});
+                    continue;
+                }
+                work.pop_back();
+                in.op = n.op;
+                if (n.op == opcode::CONST)
+                    in.value = n.value;
+                else if (n.op == opcode::VAR)
+                    in.slot = n.slot;
+                else
+                    in.fn = n.fn;
+                push(in, 1 - static_cast<long>(n.args.size()));
+                if (uses[id] > 1 && !n.args.empty())
+                {
+                    temp[id] = out.temps++;
+                    in.op = opcode::STORE;
+                    in.slot = temp[id];
+                    push(in, 0);
+                }
+            }
+
+            prog = std::move(out);
+        }
+    };
+
+    template <typename Type>
+    void optimize(program<Type> &prog)
+    {
+        optimizer<Type>().run(prog);
+    }
+}
+
+#endif
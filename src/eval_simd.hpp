@@ -0,0 +1,181 @@
+#ifndef EVAL_SIMD_HPP
+#define EVAL_SIMD_HPP
+
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__AVX__)
+#include <immintrin.h>
+#define EVAL_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EVAL_SIMD_SSE2
+#endif
+
+// 按列(lane)批量计算的内核, args[i] 指向第 i 个参数的 count 个值, out 可以与 args[0] 重合
+namespace eval
+{
+    namespace lanes
+    {
+        template <typename T, typename F>
+        inline void map1(T *out, size_t count, F f)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = f(out[i]);
+        }
+        template <typename T, typename F>
+        inline void map2(T *out, const T *rhs, size_t count, F f)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = f(out[i], rhs[i]);
+        }
+
+        template <typename T>
+        void add(const T *const *args, T *out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = args[0][i] + args[1][i];
+        }
+        template <typename T>
+        void sub(const T *const *args, T *out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = args[0][i] - args[1][i];
+        }
+        template <typename T>
+        void mul(const T *const *args, T *out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = args[0][i] * args[1][i];
+        }
+        template <typename T>
+        void div(const T *const *args, T *out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = args[0][i] / args[1][i];
+        }
+        template <typename T>
+        void neg(const T *const *args, T *out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = -args[0][i];
+        }
+        template <typename T>
+        void sqrt(const T *const *args, T *out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = std::sqrt(args[0][i]);
+        }
+        template <typename T>
+        void abs(const T *const *args, T *out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = std::abs(args[0][i]);
+        }
+        template <typename T>
+        void min(const T *const *args, T *out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = std::min(args[0][i], args[1][i]);
+        }
+        template <typename T>
+        void max(const T *const *args, T *out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+                out[i] = std::max(args[0][i], args[1][i]);
+        }
+
+#if defined(EVAL_SIMD_AVX)
+        using pd = __m256d;
+        constexpr size_t pd_width = 4;
+        inline pd pd_load(const double *p) { return _mm256_loadu_pd(p); }
+        inline void pd_store(double *p, pd v) { _mm256_storeu_pd(p, v); }
+        inline pd pd_add(pd a, pd b) { return _mm256_add_pd(a, b); }
+        inline pd pd_sub(pd a, pd b) { return _mm256_sub_pd(a, b); }
+        inline pd pd_mul(pd a, pd b) { return _mm256_mul_pd(a, b); }
+        inline pd pd_div(pd a, pd b) { return _mm256_div_pd(a, b); }
+        inline pd pd_sqrt(pd a) { return _mm256_sqrt_pd(a); }
+        inline pd pd_xor(pd a, pd b) { return _mm256_xor_pd(a, b); }
+        inline pd pd_andnot(pd a, pd b) { return _mm256_andnot_pd(a, b); }
+        inline pd pd_set1(double v) { return _mm256_set1_pd(v); }
+#elif defined(EVAL_SIMD_SSE2)
+        using pd = __m128d;
+        constexpr size_t pd_width = 2;
+        inline pd pd_load(const double *p) { return _mm_loadu_pd(p); }
+        inline void pd_store(double *p, pd v) { _mm_storeu_pd(p, v); }
+        inline pd pd_add(pd a, pd b) { return _mm_add_pd(a, b); }
+        inline pd pd_sub(pd a, pd b) { return _mm_sub_pd(a, b); }
+        inline pd pd_mul(pd a, pd b) { return _mm_mul_pd(a, b); }
+        inline pd pd_div(pd a, pd b) { return _mm_div_pd(a, b); }
+        inline pd pd_sqrt(pd a) { return _mm_sqrt_pd(a); }
+        inline pd pd_xor(pd a, pd b) { return _mm_xor_pd(a, b); }
+        inline pd pd_andnot(pd a, pd b) { return _mm_andnot_pd(a, b); }
+        inline pd pd_set1(double v) { return _mm_set1_pd(v); }
+#endif
+
+#if defined(EVAL_SIMD_AVX) || defined(EVAL_SIMD_SSE2)
+        template <pd (*op)(pd, pd)>
+        inline void pd_binary(const double *a, const double *b, double *out, size_t count, double (*tail)(double, double))
+        {
+            size_t i = 0;
+            for (; i + pd_width <= count; i += pd_width)
+                pd_store(out + i, op(pd_load(a + i), pd_load(b + i)));
+            for (; i < count; ++i)
+                out[i] = tail(a[i], b[i]);
+        }
+
+        template <>
+        inline void add<double>(const double *const *args, double *out, size_t count)
+        {
+            pd_binary<pd_add>(args[0], args[1], out, count, [](double a, double b) { return a + b; });
+        }
+        template <>
+        inline void sub<double>(const double *const *args, double *out, size_t count)
+        {
+            pd_binary<pd_sub>(args[0], args[1], out, count, [](double a, double b) { return a - b; });
+        }
+        template <>
+        inline void mul<double>(const double *const *args, double *out, size_t count)
+        {
+            pd_binary<pd_mul>(args[0], args[1], out, count, [](double a, double b) { return a * b; });
+        }
+        template <>
+        inline void div<double>(const double *const *args, double *out, size_t count)
+        {
+            pd_binary<pd_div>(args[0], args[1], out, count, [](double a, double b) { return a / b; });
+        }
+        template <>
+        inline void neg<double>(const double *const *args, double *out, size_t count)
+        {
+            const pd sign = pd_set1(-0.0);
+            size_t i = 0;
+            for (; i + pd_width <= count; i += pd_width)
+                pd_store(out + i, pd_xor(pd_load(args[0] + i), sign));
+            for (; i < count; ++i)
+                out[i] = -args[0][i];
+        }
+        template <>
+        inline void sqrt<double>(const double *const *args, double *out, size_t count)
+        {
+            size_t i = 0;
+            for (; i + pd_width <= count; i += pd_width)
+                pd_store(out + i, pd_sqrt(pd_load(args[0] + i)));
+            for (; i < count; ++i)
+                out[i] = std::sqrt(args[0][i]);
+        }
+        template <>
+        inline void abs<double>(const double *const *args, double *out, size_t count)
+        {
+            const pd sign = pd_set1(-0.0);
+            size_t i = 0;
+            for (; i + pd_width <= count; i += pd_width)
+                pd_store(out + i, pd_andnot(sign, pd_load(args[0] + i)));
+            for (; i < count; ++i)
+                out[i] = std::abs(args[0][i]);
+        }
+#endif
+    }
+}
+
+#endif
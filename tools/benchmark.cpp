@@ -0,0 +1,214 @@
+#include "MathVisualizer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// 性能基准: 每行输出 "组<TAB>用例<TAB>数值<TAB>单位", 便于对比改动前后的结果
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int RUNS = 7;
+    constexpr double MIN_RUN_MS = 50.0;
+
+    struct Case
+    {
+        const char* name;
+        std::string expression;
+    };
+
+    std::string nested(int depth)
+    {
+        std::string text = "x+y";
+        for (int i = 0; i < depth; ++i)
+            text = (i % 2 ? "sin(" : "cos(") + text + ")*1.01";
+        return text;
+    }
+
+    std::string generated(int terms)
+    {
+        std::string text = "0";
+        for (int i = 1; i <= terms; ++i)
+        {
+            const std::string k = std::to_string(i);
+            text += i % 3 == 0 ? "+" + k + "*x*y" : i % 3 == 1 ? "-sin(x+" + k + ")" : "+y^2/" + k;
+        }
+        return text;
+    }
+
+    std::vector<Case> corpus()
+    {
+        return {
+            {"polynomial", "x^5-3*x^3*y+2*x*y^4-y^5+7*x-1"},
+            {"trig", "sin(x)*cos(y)+sin(x*y)-cos(x+y)*tan(x-y)+atan2(y,x)"},
+            {"gamma", "tgamma(abs(x)+0.5)-lgamma(abs(y)+1)-1"},
+            {"nested", nested(24)},
+            {"long", generated(200)},
+        };
+    }
+
+    // 重复执行 body (每次完成 ops 个操作) 直到单轮超过 MIN_RUN_MS, 取 RUNS 轮中每个操作耗时的中位数 (纳秒)
+    template <typename Body>
+    double measure(Body&& body, size_t ops)
+    {
+        std::vector<double> samples;
+        for (int run = 0; run < RUNS; ++run)
+        {
+            size_t count = 0;
+            const auto start = Clock::now();
+            double elapsed = 0.0;
+            do
+            {
+                body();
+                count += ops;
+                elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            } while (elapsed < MIN_RUN_MS);
+            samples.push_back(elapsed * 1e6 / count);
+        }
+        std::nth_element(samples.begin(), samples.begin() + RUNS / 2, samples.end());
+        return samples[RUNS / 2];
+    }
+
+    void report(const char* group, const std::string& name, double value, const char* unit)
+    {
+        std::printf("%s\t%s\t%.3f\t%s\n", group, name.c_str(), value, unit);
+    }
+
+    // 防止被优化掉的结果汇总
+    volatile double sink = 0.0;
+
+    void benchParse(const std::vector<Case>& cases)
+    {
+        for (const Case& c : cases)
+        {
+            const double ns = measure([&]()
+            {
+                eval::epre<double> expr;
+                Equation::evaluator.parse(expr, c.expression);
+                sink = sink + static_cast<double>(expr.index.size());
+            }, 1);
+            report("parse", c.name, ns, "ns/expr");
+            report("parse", c.name, c.expression.size() * 1e3 / ns, "MB/s");
+        }
+    }
+
+    void benchEvaluate(const std::vector<Case>& cases, double* x, double* y)
+    {
+        constexpr size_t SAMPLES = 4096;
+        std::vector<double> xs(SAMPLES);
+        std::vector<double> out(SAMPLES);
+        for (size_t i = 0; i < SAMPLES; ++i)
+            xs[i] = -15.0 + 30.0 * i / SAMPLES;
+
+        for (const Case& c : cases)
+        {
+            eval::program<double> prog = Equation::evaluator.compile(Equation::evaluator.parse(c.expression));
+            eval::optimize(prog);
+            eval::context<double> context(prog);
+            context.set(prog, y, 1.25);
+
+            const double scalar = measure([&]()
+            {
+                double sum = 0.0;
+                for (double value : xs)
+                {
+                    context.set(prog, x, value);
+                    sum += Equation::evaluator.evaluate(prog, context);
+                }
+                sink = sink + sum;
+            }, SAMPLES);
+            report("evaluate", c.name, scalar, "ns/sample");
+
+            const eval::column<double> column{x, xs.data()};
+            const double batch = measure([&]()
+            {
+                Equation::evaluator.evaluate_batch(prog, context, &column, 1, out.data(), SAMPLES);
+                sink = sink + out[SAMPLES / 2];
+            }, SAMPLES);
+            report("evaluate_batch", c.name, batch, "ns/sample");
+        }
+    }
+
+    void benchLookup()
+    {
+        const std::vector<std::string> vars{"x", "y", "pi", "e", "inf"};
+        const std::vector<std::string> funcs{"sin", "cos", "atan2", "tgamma", "lgamma", "hypot", "sqrt", "floor"};
+        const double varNs = measure([&]()
+        {
+            for (const std::string& name : vars)
+                sink = sink + (Equation::evaluator.vars->search(name) ? 1.0 : 0.0);
+        }, vars.size());
+        report("sstree", "vars", varNs, "ns/lookup");
+        const double funcNs = measure([&]()
+        {
+            for (const std::string& name : funcs)
+                sink = sink + (Equation::evaluator.funcs->search(name) ? 1.0 : 0.0);
+        }, funcs.size());
+        report("sstree", "funcs", funcNs, "ns/lookup");
+    }
+
+    bool benchFrames(const std::vector<Case>& cases, const char* fontPath)
+    {
+        // 交替在两个相差不到一个采样间距的视图之间切换, 两者的采样节点互不重合, 每帧都要重新采样,
+        // 不会命中上一帧的采样缓存 (整数倍间距的平移或以中心缩放都会复用重合的节点)
+        const double shift = 0.0123457;
+        const MathRange views[] = {{-15.0, 15.0, -10.0, 10.0}, {-15.0 + shift, 15.0 + shift, -10.0 + shift, 10.0 + shift}};
+        const std::pair<size_t, size_t> settings[] = {{5, 2}, {3, 2}, {8, 2}, {5, 1}, {5, 4}};
+        for (const auto& [lstep, ffts] : settings)
+        {
+            MathVisualizer app(lstep, ffts);
+            if (!app.initHeadless(fontPath))
+            {
+                std::fprintf(stderr, "failed to create renderer: %s\n", SDL_GetError());
+                app.cleanup();
+                return false;
+            }
+            for (const Case& c : cases)
+                app.addEquation(c.expression + "=0", Constants::TEXT_COLOR);
+            app.addEquation("y=sin(x)", Constants::TEXT_COLOR);
+
+            size_t frame = 0;
+            const double ns = measure([&]()
+            {
+                app.setRange(views[frame++ % 2]);
+                app.renderFrame();
+            }, 1);
+            report("frame", "lstep=" + std::to_string(lstep) + ",ffts=" + std::to_string(ffts), ns / 1e6, "ms/frame");
+            app.cleanup();
+        }
+        return true;
+    }
+}
+
+// benchmark [-f 字体] [--no-frames]
+int main(int argc, char* argv[])
+{
+    const char* fontPath = Constants::FONT_PATH;
+    bool frames = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            fontPath = argv[++i];
+        else if (std::strcmp(argv[i], "--no-frames") == 0)
+            frames = false;
+    }
+
+    Equation::evaluator.vars->insert("x", {eval::vartype::FREEVAR, 0.0});
+    Equation::evaluator.vars->insert("y", {eval::vartype::FREEVAR, 0.0});
+    double* x = &Equation::evaluator.vars->search("x")->data->value;
+    double* y = &Equation::evaluator.vars->search("y")->data->value;
+
+#ifdef EVAL_MAP_SSTREE
+    std::printf("# symbol_table=sstree threads=%zu\n", ThreadPool().size());
+#else
+    std::printf("# symbol_table=flat_sstree threads=%zu\n", ThreadPool().size());
+#endif
+    const std::vector<Case> cases = corpus();
+    benchParse(cases);
+    benchEvaluate(cases, x, y);
+    benchLookup();
+    if (frames && !benchFrames(cases, fontPath))
+        return -1;
+    return 0;
+}
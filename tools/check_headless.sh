@@ -0,0 +1,18 @@
+#!/bin/sh
+# 检查 headless 遇到无法解析的方程时会跳过并退出, 不会卡住
+# 用法: tools/check_headless.sh path/to/headless
+set -u
+HEADLESS=${1:-./headless}
+OUT=${TMPDIR:-/tmp}/check_headless.$$.ppm
+
+for equation in '!x=1' 'x!' '-x^2+y=0'; do
+    timeout 20 "$HEADLESS" -o "$OUT" -- "$equation" y=x >/dev/null 2>&1
+    status=$?
+    if [ "$status" -eq 124 ]; then
+        echo "headless hung on: $equation" >&2
+        rm -f "$OUT"
+        exit 1
+    fi
+done
+rm -f "$OUT"
+echo "ok"
@@ -0,0 +1,76 @@
+#include "MathVisualizer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    // 多个方程依次取用的颜色
+    const SDL_Color PALETTE[] = {
+        {241, 49, 49, 255},
+        {66, 135, 245, 255},
+        {80, 200, 120, 255},
+        {245, 190, 60, 255},
+        {190, 100, 230, 255},
+        {60, 210, 210, 255},
+    };
+
+    void usage()
+    {
+        std::fprintf(stderr,
+            "usage: headless [-o file.ppm|file.bmp] [-r xmin xmax ymin ymax] [-f font] [--] equation...\n");
+    }
+}
+
+// 不打开窗口, 把方程画成图片文件, 用于没有显示设备的机器
+int main(int argc, char* argv[])
+{
+    std::string output = "plot.ppm";
+    const char* fontPath = Constants::FONT_PATH;
+    MathRange range;
+    std::vector<std::string> expressions;
+    // 只把已知的选项当作选项, 以 - 开头的方程 (如 -x^2+y) 照常接受; -- 之后的参数都是方程
+    bool options = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (options && std::strcmp(argv[i], "--") == 0)
+            options = false;
+        else if (options && std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (options && std::strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            fontPath = argv[++i];
+        else if (options && std::strcmp(argv[i], "-r") == 0 && i + 4 < argc)
+        {
+            range.xMin = std::atof(argv[++i]);
+            range.xMax = std::atof(argv[++i]);
+            range.yMin = std::atof(argv[++i]);
+            range.yMax = std::atof(argv[++i]);
+        }
+        else
+            expressions.push_back(argv[i]);
+    }
+    if (expressions.empty() || !(range.xMin < range.xMax && range.yMin < range.yMax))
+    {
+        usage();
+        return 1;
+    }
+
+    MathVisualizer app;
+    if (!app.initHeadless(fontPath))
+    {
+        std::fprintf(stderr, "failed to create renderer: %s\n", SDL_GetError());
+        app.cleanup();
+        return -1;
+    }
+    app.setRange(range);
+    const size_t colors = sizeof(PALETTE) / sizeof(PALETTE[0]);
+    for (size_t i = 0; i < expressions.size(); ++i)
+        if (!app.addEquation(expressions[i], PALETTE[i % colors]))
+            std::fprintf(stderr, "skipping invalid equation: %s\n", expressions[i].c_str());
+
+    const bool saved = app.renderToFile(output);
+    if (!saved)
+        std::fprintf(stderr, "failed to write %s\n", output.c_str());
+    app.cleanup();
+    return saved ? 0 : -1;
+}